@@ -0,0 +1,134 @@
+// Microbenchmarks for the ST7920 drawing code and the status screen.
+//
+// The display is created without a panel so SPI output is only counted, not
+// written. Each benchmark reports ns/op, heap allocations/op and SPI bytes/op.
+#include "st7920.h"
+#include "status_screen.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+
+static std::atomic<uint64_t> allocations(0);
+
+static void *countedAlloc(size_t size, size_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size==0) size = 1;
+    void *p = align>alignof(std::max_align_t) ? aligned_alloc(align, (size + align - 1) / align * align) : malloc(size);
+    if (p==nullptr) throw std::bad_alloc();
+    return p;
+}
+
+// kept out of line, inlined into a caller gcc sees free() on memory from
+// operator new and warns (-Wmismatched-new-delete)
+__attribute__((noinline)) static void countedFree(void *p) {
+    free(p);
+}
+
+void *operator new(size_t size) { return countedAlloc(size, 0); }
+void *operator new[](size_t size) { return countedAlloc(size, 0); }
+void *operator new(size_t size, std::align_val_t align) { return countedAlloc(size, (size_t)align); }
+void *operator new[](size_t size, std::align_val_t align) { return countedAlloc(size, (size_t)align); }
+
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
+void operator delete(void *p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { countedFree(p); }
+
+static uint8_t logo[] = {
+    0b00010100, 0b00111111, 0b00111111, 0b00111011,
+    0b00100011, 0b11100001, 0b10100001, 0b10100001,
+    0b10100001, 0b11100001, 0b00100001, 0b00111111,
+};
+
+static void bench(ST7920 &lcd, const char *name, const std::function<void(uint64_t)> &fn) {
+    // run for at least 200ms, after a short warm up
+    for (uint64_t i=0;i<16;i++) fn(i);
+
+    uint64_t iters = 0;
+    uint64_t allocStart = allocations.load();
+    uint64_t bytesStart = lcd.getBytesSent();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start;
+    while (end - start < std::chrono::milliseconds(200)) {
+        for (int i=0;i<64;i++) fn(iters++);
+        end = std::chrono::steady_clock::now();
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iters;
+    double allocs = (double)(allocations.load() - allocStart) / iters;
+    double bytes = (double)(lcd.getBytesSent() - bytesStart) / iters;
+
+    printf("%-24s %12.0f %12.2f %12.1f\n", name, ns, allocs, bytes);
+}
+
+int main() {
+    std::shared_ptr<ST7920> lcd(new ST7920());
+    lcd->setFontHeight(10);
+    StatusScreen screen(lcd);
+
+    printf("%-24s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "spi B/op");
+
+    bench(*lcd, "putChar", [&](uint64_t i) {
+        lcd->putChar(2, 12, '0' + i % 10);
+    });
+
+    bench(*lcd, "putString", [&](uint64_t) {
+        lcd->putString(2, 12, "Fermenter:68.5\xb0");
+    });
+
+    bench(*lcd, "setRegion (12px band)", [&](uint64_t) {
+        lcd->setRegion(2, 12, 128, 24, false);
+    });
+
+    bench(*lcd, "putBitmap (logo)", [&](uint64_t) {
+        lcd->putBitmap(0, 0, 8, logo, sizeof(logo));
+    });
+
+    bench(*lcd, "send (1 byte)", [&](uint64_t) {
+        lcd->send(0, 0, { 0x30 });
+    });
+
+    bench(*lcd, "drawRow", [&](uint64_t i) {
+        lcd->drawRow(i % 64);
+    });
+
+    bench(*lcd, "drawRegion (12px band)", [&](uint64_t) {
+        lcd->drawRegion(2, 12, 127, 23);
+    });
+
+    bench(*lcd, "drawAll", [&](uint64_t) {
+        lcd->drawAll();
+    });
+
+    bench(*lcd, "updateTime", [&](uint64_t i) {
+        screen.updateTime(1700000000 + i);
+    });
+
+    bench(*lcd, "updateSensors", [&](uint64_t i) {
+        screen.updateSensors(68.5f + (i % 2) * 0.1f, 71.2f);
+    });
+
+    bench(*lcd, "updateRelays", [&](uint64_t i) {
+        screen.updateRelays(i % 2, 68.0f, false, std::optional<float>());
+    });
+
+    bench(*lcd, "frame", [&](uint64_t i) {
+        // one control loop tick: the clock changes every 10 frames
+        screen.updateTime(1700000000 + i / 10);
+        screen.updateSensors(68.5f, 71.2f);
+        screen.updateRelays(false, 68.0f, false, std::optional<float>());
+        screen.flush();
+    });
+
+    return 0;
+}
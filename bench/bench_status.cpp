@@ -0,0 +1,206 @@
+// Compares StatusWriter against building and dumping the status with
+// nlohmann::json, which is how it used to be done.
+//
+// Before timing anything the two are checked to give identical bytes for a
+// spread of states, including missing, non-finite and extreme values. Each
+// benchmark reports ns/op, heap allocations/op and output bytes.
+#include "status_writer.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::atomic<uint64_t> allocations(0);
+
+static void *countedAlloc(size_t size, size_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size==0) size = 1;
+    void *p = align>alignof(std::max_align_t) ? aligned_alloc(align, (size + align - 1) / align * align) : malloc(size);
+    if (p==nullptr) throw std::bad_alloc();
+    return p;
+}
+
+// kept out of line, inlined into a caller gcc sees free() on memory from
+// operator new and warns (-Wmismatched-new-delete)
+__attribute__((noinline)) static void countedFree(void *p) {
+    free(p);
+}
+
+void *operator new(size_t size) { return countedAlloc(size, 0); }
+void *operator new[](size_t size) { return countedAlloc(size, 0); }
+void *operator new(size_t size, std::align_val_t align) { return countedAlloc(size, (size_t)align); }
+void *operator new[](size_t size, std::align_val_t align) { return countedAlloc(size, (size_t)align); }
+
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
+void operator delete(void *p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { countedFree(p); }
+
+#define VALUE_OR_NULL(v) v.has_value() ? nlohmann::json(v.value()) : nlohmann::json()
+
+static nlohmann::json buildStatusData(const ControllerState &state) {
+    return {
+        { "temperature", {
+            {"fermenter", VALUE_OR_NULL(state.fermenter.temp)},
+            {"ambient", VALUE_OR_NULL(state.ambient.temp)}
+        }},
+        { "trend", {
+            {"fermenter", {
+                {"smoothed", VALUE_OR_NULL(state.fermenter.smoothed)},
+                {"ratePerMinute", VALUE_OR_NULL(state.fermenter.ratePerMinute)},
+                {"rejected", state.fermenter.rejected}
+            }},
+            {"ambient", {
+                {"smoothed", VALUE_OR_NULL(state.ambient.smoothed)},
+                {"ratePerMinute", VALUE_OR_NULL(state.ambient.ratePerMinute)},
+                {"rejected", state.ambient.rejected}
+            }}
+        }},
+        { "thermostat", {
+            {"coolTargetTemp", VALUE_OR_NULL(state.setpoints.coolTarget())},
+            {"coolMinTemp", VALUE_OR_NULL(state.setpoints.coolMin())},
+            {"heatTargetTemp", VALUE_OR_NULL(state.setpoints.heatTarget())},
+            {"heatMaxTemp", VALUE_OR_NULL(state.setpoints.heatMax())}
+        }},
+        { "relay", {
+            {"cooling", state.cooling},
+            {"heating", state.heating}
+        }}
+    };
+}
+
+static std::string nlohmannEvent(const ControllerState &state) {
+    nlohmann::json status;
+    status["status"] = buildStatusData(state);
+    return status.dump();
+}
+
+static ControllerState typicalState(uint64_t i) {
+    ControllerState state;
+    state.fermenter.temp = 68.5f + (i % 10) * 0.0625f;
+    state.fermenter.smoothed = 68.53125f;
+    state.fermenter.ratePerMinute = -0.0125f;
+    state.fermenter.rejected = 3;
+    state.ambient.temp = 71.1875f;
+    state.ambient.smoothed = 71.2f;
+    state.ambient.ratePerMinute = 0.004f;
+    state.setpoints.values[parameterIndex("coolTarget")] = 68.0f;
+    state.setpoints.values[parameterIndex("coolMin")] = 35.0f;
+    state.cooling = i % 2;
+    return state;
+}
+
+static int check() {
+    const float specials[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.1f, 68.5f, 1e-4f, 1e-5f, 1.5e-5f, 0.001f,
+        123456789.0f, 1e15f, 1e16f, 3.4e38f, -3.4e38f, 1e-38f, 1e-45f,
+        std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity()
+    };
+
+    std::vector<ControllerState> states;
+    states.push_back(ControllerState());
+    states.push_back(typicalState(0));
+    for (float f : specials) {
+        ControllerState state = typicalState(1);
+        state.fermenter.temp = f;
+        state.ambient.ratePerMinute = f;
+        state.setpoints.values[parameterIndex("heatMax")] = f;
+        state.fermenter.rejected = UINT64_MAX;
+        states.push_back(state);
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> temps(-40.0f, 250.0f);
+    std::uniform_int_distribution<uint32_t> bits;
+    for (int i=0;i<200000;i++) {
+        ControllerState state = typicalState(i);
+        state.fermenter.temp = temps(rng);
+        state.fermenter.smoothed = temps(rng);
+        state.ambient.temp = temps(rng) / 1000.0f;
+        uint32_t b = bits(rng);
+        float f;
+        memcpy(&f, &b, sizeof(f));
+        state.ambient.smoothed = f;
+        for (std::optional<float> &value : state.setpoints.values) {
+            if (bits(rng) & 1) value = temps(rng);
+            else value.reset();
+        }
+        states.push_back(state);
+    }
+
+    StatusWriter writer;
+    int mismatches = 0;
+    for (const ControllerState &state : states) {
+        std::string expected = nlohmannEvent(state);
+        std::string_view got = writer.writeEvent(state);
+        if (got!=expected && mismatches++ < 5) {
+            printf("mismatch:\n  nlohmann: %s\n  writer:   %.*s\n", expected.c_str(), (int)got.size(), got.data());
+        }
+        if (writer.write(state)!=buildStatusData(state).dump()) mismatches++;
+    }
+    printf("checked %zu states, %d mismatches\n\n", states.size(), mismatches);
+    return mismatches;
+}
+
+static void bench(const char *name, const std::function<size_t(uint64_t)> &fn) {
+    // run for at least 200ms, after a short warm up
+    for (uint64_t i=0;i<16;i++) fn(i);
+
+    uint64_t iters = 0;
+    size_t bytes = 0;
+    uint64_t allocStart = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start;
+    while (end - start < std::chrono::milliseconds(200)) {
+        for (int i=0;i<64;i++) bytes = fn(iters++);
+        end = std::chrono::steady_clock::now();
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iters;
+    double allocs = (double)(allocations.load() - allocStart) / iters;
+
+    printf("%-28s %12.0f %12.2f %12zu\n", name, ns, allocs, bytes);
+}
+
+int main() {
+    if (check()) return 1;
+
+    printf("%-28s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "bytes");
+
+    std::vector<ControllerState> states;
+    for (uint64_t i=0;i<64;i++) states.push_back(typicalState(i));
+
+    bench("nlohmann status", [&](uint64_t i) {
+        return buildStatusData(states[i % 64]).dump().size();
+    });
+
+    bench("nlohmann event", [&](uint64_t i) {
+        return nlohmannEvent(states[i % 64]).size();
+    });
+
+    StatusWriter writer;
+    bench("StatusWriter status", [&](uint64_t i) {
+        return writer.write(states[i % 64]).size();
+    });
+
+    bench("StatusWriter event", [&](uint64_t i) {
+        return writer.writeEvent(states[i % 64]).size();
+    });
+
+    return 0;
+}
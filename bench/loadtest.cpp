@@ -0,0 +1,571 @@
+// Load test for the brewserver web and websocket api.
+//
+// Starts brewserver against simulated hardware (a fake 1-wire sysfs tree and
+// in-memory relays/lcd), then runs N keep-alive /status pollers and M
+// /websocket subscribers over loopback TCP, or over a unix domain socket with
+// --unix. Results are written as JSON.
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef BREWSERVER_PATH
+#define BREWSERVER_PATH "brewserver"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    std::string server = BREWSERVER_PATH;
+    int port = 18000;
+    // set to run over a unix socket in the work directory instead of tcp
+    std::string unixSocket;
+    int httpClients = 8;
+    int wsClients = 8;
+    // server web threads, 0 sizes them from the client counts
+    int webThreads = 0;
+    int duration = 10;
+    std::string output;
+};
+
+static std::atomic<bool> running(true);
+
+static int connectServer(const Config &cfg) {
+    int fd;
+    if (cfg.unixSocket.empty()) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd==-1) return -1;
+
+        struct sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(cfg.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))==-1) {
+            close(fd);
+            return -1;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    } else {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd==-1) return -1;
+
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, cfg.unixSocket.c_str(), sizeof(addr.sun_path) - 1);
+
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))==-1) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    struct timeval tv{};
+    tv.tv_sec = 5;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    return fd;
+}
+
+static bool sendAll(int fd, const char *data, size_t len) {
+    while (len>0) {
+        ssize_t r = send(fd, data, len, MSG_NOSIGNAL);
+        if (r<=0) return false;
+        data += r;
+        len -= r;
+    }
+    return true;
+}
+
+// Buffered reader over a socket
+class Reader {
+public:
+    Reader(int fd) : fd(fd) { }
+
+    bool readLine(std::string &line) {
+        line.clear();
+        while (true) {
+            size_t nl = this->buf.find("\r\n", this->pos);
+            if (nl!=std::string::npos) {
+                line.assign(this->buf, this->pos, nl - this->pos);
+                this->pos = nl + 2;
+                return true;
+            }
+            if (!this->fill()) return false;
+        }
+    }
+
+    bool readExact(size_t n, std::string *out) {
+        while (this->buf.size() - this->pos < n) {
+            if (!this->fill()) return false;
+        }
+        if (out) out->assign(this->buf, this->pos, n);
+        this->pos += n;
+        return true;
+    }
+
+private:
+    int fd;
+    std::string buf;
+    size_t pos = 0;
+
+    bool fill() {
+        if (this->pos>0) {
+            this->buf.erase(0, this->pos);
+            this->pos = 0;
+        }
+        char tmp[4096];
+        ssize_t r = recv(this->fd, tmp, sizeof(tmp), 0);
+        if (r<=0) return false;
+        this->buf.append(tmp, r);
+        return true;
+    }
+};
+
+// Reads response headers, returns the status code or -1
+static int readResponseHead(Reader &reader, long &contentLength, bool &close) {
+    std::string line;
+    if (!reader.readLine(line)) return -1;
+    if (line.size()<12) return -1;
+    int status = std::atoi(line.c_str() + 9);
+
+    contentLength = -1;
+    close = line.compare(0, 8, "HTTP/1.0")==0;
+    while (reader.readLine(line)) {
+        if (line.empty()) return status;
+        std::string lower(line);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.rfind("content-length:", 0)==0) contentLength = std::atol(line.c_str() + 15);
+        if (lower.rfind("connection:", 0)==0 && lower.find("close")!=std::string::npos) close = true;
+    }
+    return -1;
+}
+
+static bool httpGet(const Config &cfg, const std::string &path, std::string &body) {
+    int fd = connectServer(cfg);
+    if (fd==-1) return false;
+
+    std::string req = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+    bool ok = sendAll(fd, req.data(), req.size());
+
+    Reader reader(fd);
+    long contentLength;
+    bool connClose;
+    ok = ok && readResponseHead(reader, contentLength, connClose)==200;
+    ok = ok && contentLength>=0 && reader.readExact(contentLength, &body);
+
+    close(fd);
+    return ok;
+}
+
+struct HttpResult {
+    // got at least one response, a client the server never gets to only times out
+    bool served = false;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t reconnects = 0;
+    std::vector<uint32_t> latencyUs;
+};
+
+static void runHttpClient(const Config &cfg, HttpResult &result) {
+    const std::string req = "GET /status HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    int fd = -1;
+    std::unique_ptr<Reader> reader;
+
+    while (running) {
+        if (fd==-1) {
+            fd = connectServer(cfg);
+            if (fd==-1) {
+                result.errors++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            reader.reset(new Reader(fd));
+            if (result.requests>0) result.reconnects++;
+        }
+
+        Clock::time_point start = Clock::now();
+        long contentLength;
+        bool connClose;
+        bool ok = sendAll(fd, req.data(), req.size());
+        ok = ok && readResponseHead(*reader, contentLength, connClose)==200;
+        ok = ok && contentLength>=0 && reader->readExact(contentLength, nullptr);
+        Clock::time_point end = Clock::now();
+
+        // a response that only arrives once the run is over was waiting for
+        // a server thread the whole time, it doesn't count
+        if (ok && running) {
+            result.served = true;
+            result.requests++;
+            result.latencyUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+        } else if (running) {
+            result.errors++;
+        }
+
+        if (!ok || connClose) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd!=-1) close(fd);
+}
+
+struct WsResult {
+    // completed the handshake
+    bool served = false;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    std::vector<uint32_t> gapUs;
+};
+
+static bool wsSendMasked(int fd, uint8_t opcode, const std::string &payload) {
+    // control frames only, payload always < 126 bytes
+    std::string frame;
+    frame.push_back((char)(0x80 | opcode));
+    frame.push_back((char)(0x80 | payload.size()));
+    const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    frame.append((const char*)mask, 4);
+    for (size_t i=0;i<payload.size();i++) frame.push_back(payload[i] ^ mask[i % 4]);
+    return sendAll(fd, frame.data(), frame.size());
+}
+
+static void runWsClient(const Config &cfg, WsResult &result) {
+    int fd = connectServer(cfg);
+    if (fd==-1) {
+        result.errors++;
+        return;
+    }
+
+    const std::string req =
+        "GET /websocket HTTP/1.1\r\n"
+        "Host: 127.0.0.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n";
+
+    Reader reader(fd);
+    long contentLength;
+    bool connClose;
+    if (!sendAll(fd, req.data(), req.size()) || readResponseHead(reader, contentLength, connClose)!=101) {
+        result.errors++;
+        close(fd);
+        return;
+    }
+    result.served = true;
+
+    Clock::time_point last;
+    std::string hdr, payload;
+    while (running) {
+        if (!reader.readExact(2, &hdr)) {
+            if (running) result.errors++;
+            break;
+        }
+        uint8_t opcode = hdr[0] & 0x0f;
+        uint64_t len = hdr[1] & 0x7f;
+        if (len==126) {
+            if (!reader.readExact(2, &hdr)) break;
+            len = ((uint8_t)hdr[0] << 8) | (uint8_t)hdr[1];
+        } else if (len==127) {
+            if (!reader.readExact(8, &hdr)) break;
+            len = 0;
+            for (int i=0;i<8;i++) len = (len << 8) | (uint8_t)hdr[i];
+        }
+        if (!reader.readExact(len, &payload)) break;
+
+        if (opcode==0x9) {
+            wsSendMasked(fd, 0xa, payload);
+        } else if (opcode==0x8) {
+            break;
+        } else if (opcode==0x1 || opcode==0x2) {
+            Clock::time_point now = Clock::now();
+            if (result.messages>0) {
+                result.gapUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - last).count());
+            }
+            last = now;
+            result.messages++;
+            result.bytes += len;
+        }
+    }
+
+    wsSendMasked(fd, 0x8, "");
+    close(fd);
+}
+
+static nlohmann::json percentiles(std::vector<uint32_t> &samples, double scale) {
+    if (samples.empty()) return nlohmann::json();
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double p) {
+        size_t i = std::min(samples.size() - 1, (size_t)(p * samples.size()));
+        return samples[i] / scale;
+    };
+    return {
+        { "p50", at(0.50) },
+        { "p99", at(0.99) },
+        { "p999", at(0.999) },
+        { "max", samples.back() / scale }
+    };
+}
+
+// Parses the cumulative buckets of a prometheus histogram: le (seconds) -> count
+static std::map<double, uint64_t> parseHistogram(const std::string &metrics, const std::string &name) {
+    std::map<double, uint64_t> buckets;
+    std::string prefix = name + "_bucket{le=\"";
+    size_t pos = 0;
+    while ((pos = metrics.find(prefix, pos))!=std::string::npos) {
+        pos += prefix.size();
+        size_t q = metrics.find('"', pos);
+        std::string le = metrics.substr(pos, q - pos);
+        double bound = le=="+Inf" ? INFINITY : std::atof(le.c_str());
+        buckets[bound] = std::strtoull(metrics.c_str() + metrics.find(' ', q) + 1, nullptr, 10);
+    }
+    return buckets;
+}
+
+static nlohmann::json histogramDelta(const std::string &before, const std::string &after, const std::string &name) {
+    std::map<double, uint64_t> b = parseHistogram(before, name);
+    std::map<double, uint64_t> a = parseHistogram(after, name);
+    if (a.empty()) return nlohmann::json();
+
+    uint64_t total = a.rbegin()->second - b[INFINITY];
+    nlohmann::json r = { { "count", total } };
+    for (auto [key, p] : std::initializer_list<std::pair<const char*, double>>{ {"p50", 0.5}, {"p99", 0.99}, {"p999", 0.999} }) {
+        r[key] = nullptr;
+        for (auto &[bound, count] : a) {
+            if (total>0 && count - b[bound] >= p * total) {
+                // upper bound of the bucket holding the percentile, in ms
+                r[key] = std::isinf(bound) ? nlohmann::json("+Inf") : nlohmann::json(bound * 1000.0);
+                break;
+            }
+        }
+    }
+    return r;
+}
+
+static void writeFile(const std::filesystem::path &path, const std::string &content) {
+    std::ofstream f(path, std::ios::out);
+    f << content;
+}
+
+static pid_t startServer(const Config &cfg, const std::filesystem::path &dir) {
+    std::filesystem::path w1 = dir / "w1";
+    for (const char *id : { "28-0517602ef2ff", "28-0517609e1fff" }) {
+        std::filesystem::create_directories(w1 / id);
+        writeFile(w1 / id / "temperature", "19875\n");
+    }
+
+    std::string listen = cfg.unixSocket.empty() ? "127.0.0.1:" + std::to_string(cfg.port) : "none";
+    std::string threads = std::to_string(cfg.webThreads);
+    std::string logPath = (dir / "server.log").string();
+    std::string w1Str = w1.string();
+
+    pid_t pid = fork();
+    if (pid==0) {
+        setenv("HOME", dir.c_str(), 1);
+        int logFd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(logFd, 1);
+        dup2(logFd, 2);
+        if (cfg.unixSocket.empty()) {
+            execl(cfg.server.c_str(), cfg.server.c_str(), "--simulate", "--listen", listen.c_str(), "--web-threads", threads.c_str(),
+                "--w1-dir", w1Str.c_str(), (char*)nullptr);
+        } else {
+            execl(cfg.server.c_str(), cfg.server.c_str(), "--simulate", "--listen", listen.c_str(), "--unix-socket", cfg.unixSocket.c_str(),
+                "--web-threads", threads.c_str(), "--w1-dir", w1Str.c_str(), (char*)nullptr);
+        }
+        _exit(127);
+    }
+    return pid;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [options]\n", prog);
+    fprintf(stderr, "  --server PATH     brewserver binary (default %s)\n", BREWSERVER_PATH);
+    fprintf(stderr, "  --port PORT       loopback port to run the server on (default 18000)\n");
+    fprintf(stderr, "  --unix            connect over a unix domain socket instead of tcp\n");
+    fprintf(stderr, "  --http N          concurrent keep-alive /status clients (default 8)\n");
+    fprintf(stderr, "  --ws M            concurrent /websocket subscribers (default 8)\n");
+    fprintf(stderr, "  --web-threads N   server web threads (default one per client plus 4)\n");
+    fprintf(stderr, "  --duration S      seconds to run (default 10)\n");
+    fprintf(stderr, "  --output FILE     write JSON results to FILE instead of stdout\n");
+}
+
+int main(int argc, char *argv[]) {
+    Config cfg;
+    bool useUnix = false;
+
+    static const struct option longOpts[] = {
+        { "server",   required_argument, nullptr, 's' },
+        { "port",     required_argument, nullptr, 'p' },
+        { "unix",     no_argument,       nullptr, 'u' },
+        { "http",     required_argument, nullptr, 'n' },
+        { "ws",       required_argument, nullptr, 'm' },
+        { "web-threads", required_argument, nullptr, 't' },
+        { "duration", required_argument, nullptr, 'd' },
+        { "output",   required_argument, nullptr, 'o' },
+        { "help",     no_argument,       nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    int o;
+    while ((o = getopt_long(argc, argv, "", longOpts, nullptr))!=-1) {
+        switch (o) {
+        case 's': cfg.server = optarg; break;
+        case 'p': cfg.port = std::atoi(optarg); break;
+        case 'u': useUnix = true; break;
+        case 'n': cfg.httpClients = std::atoi(optarg); break;
+        case 'm': cfg.wsClients = std::atoi(optarg); break;
+        case 't': cfg.webThreads = std::atoi(optarg); break;
+        case 'd': cfg.duration = std::atoi(optarg); break;
+        case 'o': cfg.output = optarg; break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return 1;
+        }
+    }
+
+    // every client holds a server thread for the whole run, plus the /metrics
+    // polls and some headroom; with fewer the extra clients are never served
+    if (cfg.webThreads<=0) cfg.webThreads = cfg.httpClients + cfg.wsClients + 4;
+
+    char dirTemplate[] = "/tmp/brewserver-loadtest-XXXXXX";
+    if (mkdtemp(dirTemplate)==nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::filesystem::path dir(dirTemplate);
+    if (useUnix) cfg.unixSocket = (dir / "brewserver.sock").string();
+
+    pid_t server = startServer(cfg, dir);
+    fprintf(stderr, "started %s (pid %d), logging to %s\n", cfg.server.c_str(), server, (dir / "server.log").c_str());
+
+    std::string metricsBefore;
+    bool up = false;
+    for (int i=0;i<100 && !up;i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        up = httpGet(cfg, "/metrics", metricsBefore);
+    }
+    if (!up) {
+        fprintf(stderr, "server did not come up on %s\n", cfg.unixSocket.empty() ? std::to_string(cfg.port).c_str() : cfg.unixSocket.c_str());
+        kill(server, SIGTERM);
+        waitpid(server, nullptr, 0);
+        return 1;
+    }
+
+    std::vector<HttpResult> httpResults(cfg.httpClients);
+    std::vector<WsResult> wsResults(cfg.wsClients);
+    std::vector<std::thread> threads;
+
+    fprintf(stderr, "running %d http + %d websocket clients for %ds\n", cfg.httpClients, cfg.wsClients, cfg.duration);
+    Clock::time_point start = Clock::now();
+    for (auto &r : wsResults) threads.emplace_back(runWsClient, std::cref(cfg), std::ref(r));
+    for (auto &r : httpResults) threads.emplace_back(runHttpClient, std::cref(cfg), std::ref(r));
+
+    std::this_thread::sleep_for(std::chrono::seconds(cfg.duration));
+
+    std::string metricsAfter;
+    httpGet(cfg, "/metrics", metricsAfter);
+
+    running = false;
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto &t : threads) t.join();
+    kill(server, SIGTERM);
+
+    int serverStatus = 0;
+    waitpid(server, &serverStatus, 0);
+
+    HttpResult http;
+    int httpUnserved = 0;
+    for (auto &r : httpResults) {
+        if (!r.served) httpUnserved++;
+        http.requests += r.requests;
+        http.errors += r.errors;
+        http.reconnects += r.reconnects;
+        http.latencyUs.insert(http.latencyUs.end(), r.latencyUs.begin(), r.latencyUs.end());
+    }
+
+    WsResult ws;
+    int wsUnserved = 0;
+    for (auto &r : wsResults) {
+        if (!r.served) wsUnserved++;
+        ws.messages += r.messages;
+        ws.bytes += r.bytes;
+        ws.errors += r.errors;
+        ws.gapUs.insert(ws.gapUs.end(), r.gapUs.begin(), r.gapUs.end());
+    }
+
+    nlohmann::json result = {
+        { "config", {
+            { "transport", cfg.unixSocket.empty() ? "tcp" : "unix" },
+            { "httpClients", cfg.httpClients },
+            { "wsClients", cfg.wsClients },
+            { "webThreads", cfg.webThreads },
+            { "durationSeconds", elapsed }
+        }},
+        { "http", {
+            { "requests", http.requests },
+            { "errors", http.errors },
+            { "reconnects", http.reconnects },
+            { "unserved", httpUnserved },
+            { "requestsPerSecond", http.requests / elapsed },
+            { "latencyMs", percentiles(http.latencyUs, 1000.0) }
+        }},
+        { "websocket", {
+            { "messages", ws.messages },
+            { "errors", ws.errors },
+            { "unserved", wsUnserved },
+            { "messagesPerSecond", ws.messages / elapsed },
+            { "bytesPerSecond", ws.bytes / elapsed },
+            { "intervalMs", percentiles(ws.gapUs, 1000.0) }
+        }},
+        { "loop", {
+            { "jitterMs", histogramDelta(metricsBefore, metricsAfter, "brewserver_loop_jitter_seconds") },
+            { "workMs", histogramDelta(metricsBefore, metricsAfter, "brewserver_loop_work_seconds") }
+        }},
+        { "serverExitStatus", WIFEXITED(serverStatus) ? WEXITSTATUS(serverStatus) : -1 }
+    };
+
+    if (httpUnserved>0 || wsUnserved>0) {
+        fprintf(stderr, "%d http and %d websocket clients were never served, the results don't measure them\n", httpUnserved, wsUnserved);
+    }
+
+    std::string out = result.dump(2) + "\n";
+    if (cfg.output.empty()) {
+        fputs(out.c_str(), stdout);
+    } else {
+        writeFile(cfg.output, out);
+    }
+
+    if (http.errors==0 && ws.errors==0 && httpUnserved==0 && wsUnserved==0) {
+        std::filesystem::remove_all(dir);
+        return 0;
+    }
+    fprintf(stderr, "errors during run, server log kept in %s\n", dir.c_str());
+    return 2;
+}
@@ -0,0 +1,64 @@
+#include "access_log.h"
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include <chrono>
+#include <cstring>
+
+AccessLog::AccessLog(int perSecond)
+:perSecond(perSecond) {
+    const char *prefixes[] = { "/status", "/set/", "/clear/", "/metrics", "/events", "/export", "/websocket", "" };
+    for (size_t i=0;i<this->routes.size();i++) {
+        this->routes[i].prefix = prefixes[i];
+        this->routes[i].window = 0;
+        this->routes[i].count = 0;
+        this->routes[i].pending = 0;
+        this->routes[i].suppressed = 0;
+    }
+}
+
+AccessLog::Route &AccessLog::route(const char *uri) {
+    for (size_t i=0;i<this->routes.size()-1;i++) {
+        if (strncmp(uri, this->routes[i].prefix, strlen(this->routes[i].prefix))==0) return this->routes[i];
+    }
+    return this->routes.back();
+}
+
+void AccessLog::log(std::string_view remote, const char *method, const char *uri, int status) {
+    Route &route = this->route(uri);
+
+    // errors are always logged, only successful requests are rate limited
+    if (status>=400) {
+        spdlog::warn("{} {} {} -> {}", remote, method, uri, status);
+        return;
+    }
+
+    if (this->perSecond>0) {
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t window = route.window.load(std::memory_order_relaxed);
+        if (window!=now && route.window.compare_exchange_strong(window, now, std::memory_order_relaxed)) {
+            route.count.store(0, std::memory_order_relaxed);
+        }
+
+        if (route.count.fetch_add(1, std::memory_order_relaxed) >= (uint32_t)this->perSecond) {
+            route.pending.fetch_add(1, std::memory_order_relaxed);
+            route.suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    uint64_t pending = route.pending.exchange(0, std::memory_order_relaxed);
+    if (pending) {
+        spdlog::info("{} {} {} -> {} ({} similar not logged)", remote, method, uri, status, pending);
+    } else {
+        spdlog::info("{} {} {} -> {}", remote, method, uri, status);
+    }
+}
+
+void AccessLog::writePrometheus(std::string &out) {
+    out += "# HELP brewserver_access_log_suppressed_total Requests left out of the access log by the rate limit\n";
+    out += "# TYPE brewserver_access_log_suppressed_total counter\n";
+    for (Route &route : this->routes) {
+        const char *name = route.prefix[0] ? route.prefix : "other";
+        out += fmt::format("brewserver_access_log_suppressed_total{{route=\"{}\"}} {}\n", name, route.suppressed.load(std::memory_order_relaxed));
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Per-route rate limit on access log lines, so a dashboard polling /status a
+// few times a second doesn't fill the SD card. Each route gets perSecond lines
+// a second; the rest are counted and the count is logged with the next line
+// that gets through. A perSecond of 0 logs every request. Errors (4xx and 5xx)
+// are always logged and don't count against the limit.
+class AccessLog {
+public:
+    AccessLog(int perSecond);
+
+    void log(std::string_view remote, const char *method, const char *uri, int status);
+
+    void writePrometheus(std::string &out);
+
+private:
+    struct Route {
+        const char *prefix;
+        std::atomic<int64_t> window;
+        std::atomic<uint32_t> count;
+        std::atomic<uint64_t> pending;
+        std::atomic<uint64_t> suppressed;
+    };
+
+    int perSecond;
+    // the last one catches everything else
+    std::array<Route, 8> routes;
+
+    Route &route(const char *uri);
+};
@@ -0,0 +1,305 @@
+#include "aggregator.h"
+#include "realtime.h"
+#include "web_util.h"
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <random>
+
+static Aggregator *aggregator = nullptr;
+
+// upstreams publish every second
+#define STALE_AFTER 3
+// no message for this long and the connection is assumed dead and replaced
+#define DEAD_AFTER 10
+#define RECONNECT_MIN_MS 500
+#define RECONNECT_MAX_MS 30000
+
+#define VALUE_OR_NULL(v) v.has_value() ? nlohmann::json(v.value()) : nlohmann::json()
+
+void Aggregator::handleSignal(int signal, siginfo_t *info, void *ucontext) {
+    std::string sigName = signal==SIGTERM ? "SIGTERM" : "SIGINT";
+    spdlog::warn("Caught {}, shutting down", sigName);
+    aggregator->runLoop = false;
+}
+
+int Aggregator::run(const Options &options) {
+    spdlog::info("===============================");
+    spdlog::info("  Brewserver Aggregator Startup");
+    spdlog::info("-------------------------------");
+
+    Aggregator agg(options);
+    aggregator = &agg;
+    int r = agg._run();
+    aggregator = nullptr;
+
+    spdlog::info("-------------------------------");
+    spdlog::info("  Brewserver Aggregator Shutdown");
+    spdlog::info("===============================");
+    return r;
+}
+
+Aggregator::Aggregator(const Options &options)
+:options(options), runLoop(true), accessLog(options.accessLogRate), ctx(nullptr) {
+    for (const UpstreamAddress &address : this->options.upstreams) {
+        std::shared_ptr<Upstream> upstream(new Upstream());
+        upstream->aggregator = this;
+        upstream->address = address;
+        upstream->connected = false;
+        upstream->closed = true;
+        upstream->received = false;
+        upstream->connects = 0;
+        this->upstreams.push_back(upstream);
+    }
+
+    this->snapshot.store(std::make_shared<const std::string>(this->buildSnapshot().dump()));
+}
+
+int Aggregator::_run() {
+    struct sigaction sa{};
+    sa.sa_sigaction = &Aggregator::handleSignal;
+    sa.sa_flags = SA_SIGINFO;
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+
+    this->setupWebServer();
+
+    for (std::shared_ptr<Upstream> &upstream : this->upstreams) {
+        spdlog::info("Aggregating {} from {}:{}", upstream->address.name, upstream->address.host, upstream->address.port);
+        upstream->thread.reset(new std::thread(std::bind(&Aggregator::runUpstream, this, std::ref(*upstream))));
+    }
+
+    PeriodicTimer timer(std::chrono::seconds(1));
+    while (this->runLoop) {
+        // serialized once, /status serves it as is and websockets get it wrapped
+        std::shared_ptr<const std::string> snapshot = std::make_shared<const std::string>(this->buildSnapshot().dump());
+        this->snapshot.store(snapshot);
+        this->websockets.broadcast("{\"status\":" + *snapshot + "}");
+
+        timer.wait();
+    }
+
+    for (std::shared_ptr<Upstream> &upstream : this->upstreams) {
+        {
+            std::lock_guard<std::mutex> lock(upstream->lock);
+            upstream->wake.notify_all();
+        }
+        upstream->thread->join();
+    }
+
+    spdlog::info("Stopping webserver");
+    stopWebServer(this->ctx, this->options);
+    mg_exit_library();
+
+    return 0;
+}
+
+void Aggregator::runUpstream(Upstream &upstream) {
+    const UpstreamAddress &address = upstream.address;
+    std::chrono::milliseconds backoff(RECONNECT_MIN_MS);
+    std::minstd_rand rng(std::random_device{}());
+
+    while (this->runLoop) {
+        {
+            std::lock_guard<std::mutex> lock(upstream.lock);
+            upstream.closed = false;
+        }
+
+        char error[256] = "";
+        struct mg_connection *conn = mg_connect_websocket_client(address.host.c_str(), address.port, 0, error, sizeof(error),
+            "/websocket", NULL, &Aggregator::handleUpstreamData, &Aggregator::handleUpstreamClosed, &upstream);
+
+        std::unique_lock<std::mutex> lock(upstream.lock);
+        if (conn!=nullptr) {
+            spdlog::info("Connected to upstream {}", address.name);
+            // it may have closed again already
+            upstream.connected = !upstream.closed;
+            upstream.received = false;
+            upstream.lastActivity = std::chrono::steady_clock::now();
+            upstream.connects++;
+
+            while (this->runLoop && upstream.connected) {
+                upstream.wake.wait_for(lock, std::chrono::seconds(1));
+                if (upstream.connected && std::chrono::steady_clock::now() - upstream.lastActivity > std::chrono::seconds(DEAD_AFTER)) {
+                    spdlog::warn("Nothing from upstream {} in {}s, reconnecting", address.name, DEAD_AFTER);
+                    break;
+                }
+            }
+            upstream.connected = false;
+            bool received = upstream.received;
+
+            // closing joins civetweb's client thread, which takes the lock in its close handler
+            lock.unlock();
+            mg_close_connection(conn);
+            spdlog::info("Disconnected from upstream {}", address.name);
+
+            if (!this->runLoop) break;
+            // a connection that worked resets the backoff, one that's
+            // dropped straight away is retried like a failed connect
+            if (received) {
+                backoff = std::chrono::milliseconds(RECONNECT_MIN_MS);
+                continue;
+            }
+            lock.lock();
+        } else {
+            spdlog::warn("Couldn't connect to upstream {} ({}:{}): {}", address.name, address.host, address.port, error);
+        }
+
+        // up to 25% jitter, so upstreams that went down together aren't retried in step
+        std::chrono::milliseconds wait = backoff + std::chrono::milliseconds(rng() % (backoff.count() / 4 + 1));
+        upstream.wake.wait_for(lock, wait, [this]() { return !this->runLoop; });
+        backoff = std::min(backoff * 2, std::chrono::milliseconds(RECONNECT_MAX_MS));
+    }
+}
+
+int Aggregator::handleUpstreamData(struct mg_connection *c, int bits, char *data, size_t len, void *cbdata) {
+    Upstream *upstream = (Upstream*)cbdata;
+    int opcode = bits & 0x0f;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (opcode==MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE) return 0;
+
+    std::optional<nlohmann::json> status;
+    if (opcode==MG_WEBSOCKET_OPCODE_TEXT) {
+        nlohmann::json message = nlohmann::json::parse(data, data + len, nullptr, false);
+        if (!message.is_discarded() && message.is_object() && message.contains("status")) {
+            status = std::move(message["status"]);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(upstream->lock);
+    upstream->lastActivity = now;
+    if (status.has_value()) {
+        upstream->status = std::move(status);
+        upstream->lastUpdate = now;
+        upstream->received = true;
+    }
+    return 1;
+}
+
+void Aggregator::handleUpstreamClosed(const struct mg_connection *c, void *cbdata) {
+    Upstream *upstream = (Upstream*)cbdata;
+    std::lock_guard<std::mutex> lock(upstream->lock);
+    upstream->connected = false;
+    upstream->closed = true;
+    upstream->wake.notify_all();
+}
+
+nlohmann::json Aggregator::buildSnapshot() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    nlohmann::json nodes = nlohmann::json::object();
+
+    for (std::shared_ptr<Upstream> &upstream : this->upstreams) {
+        std::lock_guard<std::mutex> lock(upstream->lock);
+
+        std::optional<double> age;
+        if (upstream->status.has_value()) age = std::chrono::duration<double>(now - upstream->lastUpdate).count();
+
+        nodes[upstream->address.name] = {
+            {"upstream", fmt::format("{}:{}", upstream->address.host, upstream->address.port)},
+            {"online", upstream->connected},
+            {"stale", !age.has_value() || age.value() > STALE_AFTER},
+            {"age", VALUE_OR_NULL(age)},
+            {"status", upstream->status.has_value() ? upstream->status.value() : nlohmann::json()}
+        };
+    }
+
+    return {{"nodes", nodes}};
+}
+
+void Aggregator::handleEndRequest(const struct mg_connection *c, int replyStatus) {
+    if (replyStatus<0) return;
+    Aggregator *agg = (Aggregator*)mg_get_user_data(mg_get_context(c));
+    const struct mg_request_info *req = mg_get_request_info(c);
+
+    agg->accessLog.log(remoteAddress(c), req->request_method, req->local_uri, replyStatus);
+}
+
+int Aggregator::handleStatusRequest(struct mg_connection *c, void *data) {
+    Aggregator *agg = (Aggregator*)data;
+    std::shared_ptr<const std::string> snapshot = agg->snapshot.load();
+
+    mg_printf(c, "HTTP/1.1 200 OK\r\n");
+    mg_printf(c, "Content-Type: application/json\r\n");
+    mg_printf(c, "Content-Length: %zu\r\n", snapshot->size());
+    mg_printf(c, "\r\n");
+    mg_write(c, snapshot->data(), snapshot->size());
+
+    return 200;
+}
+
+int Aggregator::handleMetricsRequest(struct mg_connection *c, void *data) {
+    Aggregator *agg = (Aggregator*)data;
+    std::string metrics;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    metrics += "# HELP brewserver_upstream_up Whether the upstream's websocket is connected\n";
+    metrics += "# TYPE brewserver_upstream_up gauge\n";
+    std::string ages;
+    std::string connects;
+    for (std::shared_ptr<Upstream> &upstream : agg->upstreams) {
+        std::lock_guard<std::mutex> lock(upstream->lock);
+        const std::string &name = upstream->address.name;
+        metrics += fmt::format("brewserver_upstream_up{{node=\"{}\"}} {}\n", name, upstream->connected ? 1 : 0);
+        if (upstream->status.has_value()) {
+            ages += fmt::format("brewserver_upstream_age_seconds{{node=\"{}\"}} {}\n", name, std::chrono::duration<double>(now - upstream->lastUpdate).count());
+        }
+        connects += fmt::format("brewserver_upstream_connects_total{{node=\"{}\"}} {}\n", name, upstream->connects);
+    }
+    metrics += "# HELP brewserver_upstream_age_seconds Time since the upstream's last status\n";
+    metrics += "# TYPE brewserver_upstream_age_seconds gauge\n";
+    metrics += ages;
+    metrics += "# HELP brewserver_upstream_connects_total Websocket connections made to the upstream\n";
+    metrics += "# TYPE brewserver_upstream_connects_total counter\n";
+    metrics += connects;
+
+    metrics += "# HELP brewserver_websocket_clients Connected websocket clients\n";
+    metrics += "# TYPE brewserver_websocket_clients gauge\n";
+    metrics += "brewserver_websocket_clients " + std::to_string(agg->websockets.size()) + "\n";
+    agg->accessLog.writePrometheus(metrics);
+
+    mg_printf(c, "HTTP/1.1 200 OK\r\n");
+    mg_printf(c, "Content-Type: text/plain; version=0.0.4\r\n");
+    mg_printf(c, "Content-Length: %zu\r\n", metrics.size());
+    mg_printf(c, "\r\n");
+    mg_write(c, metrics.data(), metrics.size());
+
+    return 200;
+}
+
+int Aggregator::handleWebsocketConnected(const struct mg_connection *c, void *data) {
+    return 0;
+}
+
+void Aggregator::handleWebsocketReady(struct mg_connection *c, void *data) {
+    Aggregator *agg = (Aggregator*)data;
+    agg->websockets.add(c);
+    spdlog::info("{} connected to websocket", remoteAddressStr(c));
+}
+
+int Aggregator::handleWebsocketData(struct mg_connection *c, int bits, char *data, size_t len, void *cbdata) {
+    return 1;
+}
+
+void Aggregator::handleWebsocketClosed(const struct mg_connection *c, void *data) {
+    Aggregator *agg = (Aggregator*)data;
+    agg->websockets.remove(c);
+    spdlog::info("{} disconnected from websocket", remoteAddressStr(c));
+}
+
+void Aggregator::setupWebServer() {
+    spdlog::info("Starting web server");
+    mg_init_library(MG_FEATURES_WEBSOCKET);
+
+    struct mg_callbacks cbs;
+    memset(&cbs, 0, sizeof(cbs));
+    cbs.end_request = &Aggregator::handleEndRequest;
+
+    this->ctx = startWebServer(&cbs, (void*)this, this->options);
+
+    mg_set_websocket_handler(this->ctx, "/websocket", &Aggregator::handleWebsocketConnected, &Aggregator::handleWebsocketReady, &Aggregator::handleWebsocketData, &Aggregator::handleWebsocketClosed, (void*)this);
+    mg_set_request_handler(this->ctx, "/status$", &Aggregator::handleStatusRequest, (void*)this);
+    mg_set_request_handler(this->ctx, "/metrics$", &Aggregator::handleMetricsRequest, (void*)this);
+}
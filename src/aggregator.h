@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <nlohmann/json.hpp>
+#include <civetweb.h>
+#include "options.h"
+#include "access_log.h"
+#include "websocket_fanout.h"
+
+// Runs instead of App when upstreams are given. Follows each upstream
+// brewserver's /websocket feed and serves all of them as one status, keyed by
+// node name, over /status and /websocket.
+class Aggregator {
+public:
+    static int run(const Options &options);
+
+private:
+    Aggregator(const Options &options);
+
+    struct Upstream {
+        Aggregator *aggregator;
+        UpstreamAddress address;
+        std::shared_ptr<std::thread> thread;
+
+        std::mutex lock;
+        // wakes the upstream's thread when the connection closes or on shutdown
+        std::condition_variable wake;
+        bool connected;
+        // set by civetweb's client thread when the connection goes away
+        bool closed;
+        bool received;
+        std::chrono::steady_clock::time_point lastActivity;
+
+        std::optional<nlohmann::json> status;
+        std::chrono::steady_clock::time_point lastUpdate;
+        uint64_t connects;
+    };
+
+    static void handleSignal(int signal, siginfo_t *info, void *ucontext);
+
+    Options options;
+    std::atomic<bool> runLoop;
+
+    std::vector<std::shared_ptr<Upstream>> upstreams;
+
+    // the last merged status, as served by /status
+    std::atomic<std::shared_ptr<const std::string>> snapshot;
+
+    WebsocketFanout websockets;
+    AccessLog accessLog;
+
+    struct mg_context *ctx;
+
+    void runUpstream(Upstream &upstream);
+    nlohmann::json buildSnapshot();
+
+    void setupWebServer();
+
+    static int handleUpstreamData(struct mg_connection *c, int bits, char *data, size_t len, void *cbdata);
+    static void handleUpstreamClosed(const struct mg_connection *c, void *cbdata);
+
+    static void handleEndRequest(const struct mg_connection *c, int replyStatus);
+    static int handleStatusRequest(struct mg_connection *c, void *data);
+    static int handleMetricsRequest(struct mg_connection *c, void *data);
+
+    static int handleWebsocketConnected(const struct mg_connection *c, void *data);
+    static void handleWebsocketReady(struct mg_connection *c, void *data);
+    static int handleWebsocketData(struct mg_connection *c, int bits, char *data, size_t len, void *cbdata);
+    static void handleWebsocketClosed(const struct mg_connection *c, void *data);
+
+    int _run();
+};
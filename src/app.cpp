@@ -1,41 +1,68 @@
 #include "app.h"
+#include "record_export.h"
+#include "realtime.h"
+#include "logging.h"
+#include "web_util.h"
+#include "parameters.h"
 #include <spdlog/spdlog.h>
 #include <unistd.h>
 #include <string>
 #include <ctime>
 #include <functional>
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
+#include <chrono>
+#include <future>
+#include <cmath>
+#include <algorithm>
 
 static App *app = nullptr;
 
-static uint8_t logo[] = {
-    0b00010100, 
-    0b00111111, 
-    0b00111111, 
-    0b00111011, 
-    0b00100011, 
-    0b11100001, 
-    0b10100001, 
-    0b10100001, 
-    0b10100001, 
-    0b11100001, 
-    0b00100001, 
-    0b00111111, 
-};
-
-static uint8_t arrow[] = {
-    0b11000000,
-    0b01100000,
-    0b00110000,
-    0b00011000,
-    0b00001100,
-    0b00011000,
-    0b00110000,
-    0b01100000,
-    0b11000000
-};
+static std::optional<float> probeTemp(TempSensor *sensor) {
+    if (sensor==nullptr) return std::nullopt;
+    return sensor->getTempF();
+}
+
+static int64_t unixMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// EMA weight of each new (median filtered) sample and the window the rate of change is fitted over
+#define FILTER_ALPHA 0.2f
+#define FILTER_RATE_WINDOW 300
+// a sensor with no good reading for this long is treated as failed
+#define SENSOR_MAX_AGE 10
+// how often the 1-wire directory is rescanned without an inotify event, ms
+#define PROBE_RESCAN_INTERVAL 5000
+// probes used when the config doesn't name them
+#define DEFAULT_FERMENTER_PROBE "28-0517602ef2ff"
+#define DEFAULT_AMBIENT_PROBE "28-0517609e1fff"
+
+// status snapshots kept for /events clients resuming with Last-Event-ID
+#define EVENT_HISTORY 120
+// /events clients each hold a web server thread, leave some for everything else
+#define MAX_EVENT_CLIENTS 8
+
+// control loop and lcd refresh periods
+#define CONTROL_PERIOD_US (100 * 1000)
+#define LCD_PERIOD_US (100 * 1000)
+// longest the housekeeping thread sleeps with nothing queued, ms
+#define HOUSEKEEPING_INTERVAL 1000
+// heap faulted in and locked up front in realtime mode
+#define RT_HEAP_RESERVE (8 * 1024 * 1024)
+
+// most records a websocket get-history returns, larger ranges should use /export
+#define WEBSOCKET_HISTORY_LIMIT 5000
+
+// unix times in seconds that still fit in int64 milliseconds, with room for the +999 of a range end
+#define MAX_UNIX_SECONDS (INT64_MAX / 1000 - 1)
+
+static bool unixSecondsValid(int64_t seconds) {
+    return seconds>=-MAX_UNIX_SECONDS && seconds<=MAX_UNIX_SECONDS;
+}
 
 #define VALUE_OR_NULL(v) v.has_value() ? nlohmann::json(v.value()) : nlohmann::json()
 
@@ -50,14 +77,13 @@ int App::run() {
     return app->_run();
 }
 
-void App::init(int argc, char **argv) {
+void App::init(const Options &options) {
     if (app!=nullptr) return;
 
-    
     spdlog::info("===============================");
     spdlog::info("      Brewserver Startup");
     spdlog::info("-------------------------------");
-    app = new App();
+    app = new App(options);
 }
 
 void App::cleanup() {
@@ -70,45 +96,132 @@ void App::cleanup() {
     app = nullptr;
 }
 
-App::App()
-:lcd(0, 0) {
-    spdlog::info("Setting up lcd...");
-    this->lcd.setFunctionSet(false, false);
-    this->lcd.setDisplayControl(true, false, false);
-    this->lcd.setFunctionSet(true, true);
-    this->lcd.setFontHeight(10);
+App::App(const Options &options)
+:options(options),
+ configDirty(false), loopEventsDropped(0), housekeepingWake(0), housekeepingRun(false),
+ probes(options.w1Dir, PROBE_RESCAN_INTERVAL),
+ fermenter(this->probes.add("fermenter", DEFAULT_FERMENTER_PROBE)), ambient(this->probes.add("ambient", DEFAULT_AMBIENT_PROBE)),
+ restoreCooling(false), restoreHeating(false),
+ statusFeed(EVENT_HISTORY), eventClients(0),
+ accessLog(options.accessLogRate),
+ controlRealtime(false), lcdRealtime(false) {
+    std::chrono::steady_clock::time_point startupBegin = std::chrono::steady_clock::now();
+
+    if (this->options.simulate) spdlog::warn("Running with simulated hardware");
+
+    this->startupPhase("signals", [this]() {
+        struct sigaction sa{};
+        sa.sa_sigaction = &App::handleSignal;
+        sa.sa_flags = SA_SIGINFO;
+
+        spdlog::info("Setting signal handlers...");
+        sigaction(SIGTERM, &sa, nullptr);
+        sigaction(SIGINT, &sa, nullptr);
+    });
+
+    // needed first, the saved relay state is restored when the relays are claimed
+    this->startupPhase("config", [this]() {
+        this->loadConfig();
+    });
+
+    this->startupPhase("recorder", [this]() {
+        std::string path = this->options.recordFile;
+        if (path.empty()) {
+            std::filesystem::path recordPath(getenv("HOME"));
+            recordPath /= ".brewserver-record.bin";
+            path = recordPath.string();
+        }
+        this->recorder.reset(new Recorder(path));
+    });
+
+    // the devices are independent, bring them up concurrently. Each sensor
+    // takes its first reading (~750ms on a DS18B20) before it's ready.
+    std::future<void> lcdReady = std::async(std::launch::async, [this]() {
+        this->startupPhase("lcd", [this]() {
+            spdlog::info("Setting up lcd...");
+            if (this->options.simulate) {
+                this->lcd.reset(new ST7920());
+            } else {
+                this->lcd.reset(new ST7920(0, 0));
+            }
+            this->lcd->setFunctionSet(false, false);
+            this->lcd->setDisplayControl(true, false, false);
+            this->lcd->setFunctionSet(true, true);
+            this->lcd->setFontHeight(10);
 
-    this->lcd.drawAll(); // clear
+            this->lcd->drawAll(); // clear
 
-    this->lcd.putString(2, 26, "Brewserver Loading...");
-    this->lcd.drawAll();
+            this->lcd->putString(2, 26, "Brewserver Loading...");
+            this->lcd->drawAll();
 
-    struct sigaction sa{};
-    sa.sa_sigaction = &App::handleSignal;
-    sa.sa_flags = SA_SIGINFO;
+            this->screen.reset(new StatusScreen(this->lcd));
+        });
+    });
 
-    spdlog::info("Setting signal handlers...");
-    sigaction(SIGTERM, &sa, nullptr);
-    sigaction(SIGINT, &sa, nullptr);
+    std::future<void> fermenterReady = std::async(std::launch::async, [this]() {
+        this->startupPhase("fermenter", [this]() {
+            this->probes.attach(this->fermenter.role);
+        });
+    });
 
-    spdlog::info("Starting up temp sensors...");
+    std::future<void> ambientReady = std::async(std::launch::async, [this]() {
+        this->startupPhase("ambient", [this]() {
+            this->probes.attach(this->ambient.role);
+        });
+    });
+
+    this->startupPhase("relays", [this]() {
+        this->heater.reset(new Relay(0,23,true,this->restoreHeating,this->options.simulate));
+        this->freezer.reset(new Relay(0,24,true,this->restoreCooling,this->options.simulate));
+    });
+
+    lcdReady.get();
+    fermenterReady.get();
+    ambientReady.get();
+
+    this->probes.watch();
+
+    // readers always have a state, even before the first tick
+    this->publishState();
+
+    this->startupPhase("total", startupBegin);
+}
+
+App::Probe::Probe(size_t role)
+:role(role), filter(FILTER_ALPHA, FILTER_RATE_WINDOW), sampled(nullptr), samples(0) {
+}
 
-    this->fermenter.reset(new TempSensor("28-0517602ef2ff"));
-    this->ambient.reset(new TempSensor("28-0517609e1fff"));
+void App::startupPhase(const std::string &name, const std::function<void()> &fn) {
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    fn();
+    this->startupPhase(name, begin);
+}
 
-    this->heater.reset(new Relay(0,23,true));
-    this->freezer.reset(new Relay(0,24,true));
+void App::startupPhase(const std::string &name, std::chrono::steady_clock::time_point begin) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    spdlog::info("Startup phase '{}' took {:.1f}ms", name, seconds * 1000.0);
 
-    this->loadConfig();
+    std::lock_guard<std::mutex> lock(this->startupLock);
+    this->startupTimes.emplace_back(name, seconds);
 }
 
+// Written from the published state, on the housekeeping thread
 void App::saveConfig() {
+    ControllerState state = this->state.load();
     nlohmann::json config = {
-        { "coolTarget", VALUE_OR_NULL(this->coolTarget) },
-        { "coolMin",    VALUE_OR_NULL(this->coolMin) },
-        { "heatTarget", VALUE_OR_NULL(this->heatTarget) },
-        { "heatMax",    VALUE_OR_NULL(this->heatMax) }
+        { "relays", {
+            { "cooling", state.cooling },
+            { "heating", state.heating }
+        }},
+        { "probes", {
+            { "fermenter", this->probes.getId(this->fermenter.role) },
+            { "ambient", this->probes.getId(this->ambient.role) }
+        }}
     };
+    for (const Parameter &param : parameters) {
+        std::optional<float> value = state.setpoints.get(param);
+        config[std::string(param.name)] = VALUE_OR_NULL(value);
+    }
 
     const char *home = getenv("HOME");
     std::filesystem::path configPath(home);
@@ -134,224 +247,348 @@ void App::loadConfig() {
         nlohmann::json config = nlohmann::json::parse(confFile);
         confFile.close();
 
-        if (config.contains("coolTarget")) {
-            if (config["coolTarget"].is_number()) {
-                this->coolTarget = config["coolTarget"].get<float>();
-            } else {
-                spdlog::warn("config value 'coolTarget' is wrong type, expected number.");
-            }
+        for (const Parameter &param : parameters) {
+            std::string name(param.name);
+            // missing or null is a cleared setpoint
+            if (!config.contains(name) || config[name].is_null()) continue;
 
-            if (config["coolMin"].is_number()) {
-                this->coolMin = config["coolMin"].get<float>();
+            if (!config[name].is_number()) {
+                spdlog::warn("config value '{}' is wrong type, expected number.", name);
+            } else if (!parameterValueValid(param, config[name].get<float>())) {
+                spdlog::warn("config value '{}' is out of range, expected {} to {}.", name, param.min, param.max);
             } else {
-                spdlog::warn("config value 'coolMin' is wrong type, expected number.");
+                this->setpoints.get(param) = config[name].get<float>();
             }
+        }
 
-            if (config["heatTarget"].is_number()) {
-                this->heatTarget = config["heatTarget"].get<float>();
-            } else {
-                spdlog::warn("config value 'heatTarget' is wrong type, expected number.");
-            }
+        if (config.contains("relays") && config["relays"].is_object()) {
+            nlohmann::json relays = config["relays"];
+            if (relays.contains("cooling") && relays["cooling"].is_boolean()) this->restoreCooling = relays["cooling"].get<bool>();
+            if (relays.contains("heating") && relays["heating"].is_boolean()) this->restoreHeating = relays["heating"].get<bool>();
+        }
 
-            if (config["heatMax"].is_number()) {
-                this->heatMax = config["heatMax"].get<float>();
-            } else {
-                spdlog::warn("config value 'heatMax' is wrong type, expected number.");
-            }
+        if (config.contains("probes") && config["probes"].is_object()) {
+            nlohmann::json probes = config["probes"];
+            if (probes.contains("fermenter") && probes["fermenter"].is_string()) this->probes.setId(this->fermenter.role, probes["fermenter"].get<std::string>());
+            if (probes.contains("ambient") && probes["ambient"].is_string()) this->probes.setId(this->ambient.role, probes["ambient"].get<std::string>());
         }
     }
 }
 
 App::~App() {
     // clear lcd
-    this->lcd.setRegion(0, 0, 127, 63, false);
-    this->lcd.drawAll();   
+    this->lcd->setRegion(0, 0, 127, 63, false);
+    this->lcd->drawAll();   
 }
 
 int App::_run() {
 
-    this->setupWebServer();
+    this->startupPhase("webserver", [this]() {
+        this->setupWebServer();
+    });
 
-    // clear lcd
-    this->lcd.setRegion(0, 0, 127, 63, false);
-    this->lcd.drawAll(); 
+    if (this->options.realtime) {
+        lockMemory(RT_HEAP_RESERVE);
+    }
+
+    this->lcdThread.reset(new std::thread(std::bind(&App::runLcd, this)));
+    this->housekeepingRun = true;
+    this->housekeepingThread.reset(new std::thread(std::bind(&App::runHousekeeping, this)));
+    this->publisherThread.reset(new std::thread(std::bind(&App::runPublisher, this)));
+
+    // reads /proc, so before the loop rather than on its first tick
+    this->reportBootToControl();
+
+    // last, threads created by this one after this would inherit SCHED_FIFO
+    if (this->options.realtime) {
+        this->controlRealtime = makeThreadRealtime("control", this->options.controlPriority, this->options.controlCpu);
+        prefaultStack();
+    }
 
-    this->lcd.putBitmap(0, 0, 8, logo, 12);
-    time_t lastWSSent = 0;
+    time_t lastRecorded = 0;
+    PeriodicTimer timer(std::chrono::microseconds(CONTROL_PERIOD_US));
     while(this->runLoop) {
-        
-        std::optional<float> ferm = this->fermenter->getTempF();
-        std::optional<float> amb = this->ambient->getTempF();
-        if (this->coolTarget.has_value() && ferm.has_value() && amb.has_value()) {
-            bool coolTurnOn = false;
+        std::chrono::steady_clock::time_point tick = std::chrono::steady_clock::now();
+
+        double tickSeconds = std::chrono::duration<double>(tick.time_since_epoch()).count();
+        this->filterSample(this->fermenter, tickSeconds);
+        this->filterSample(this->ambient, tickSeconds);
+
+        // saved once the tick's state is published, the config is written from it
+        bool saveNeeded = this->applyCommands();
+
+        // decide on where the fermenter is heading, not where it is
+        std::optional<float> ferm = this->fermenter.filter.predict(this->options.anticipation);
+        std::optional<float> amb = this->ambient.filter.getSmoothed();
 
-            if (ferm > this->coolTarget.value()) {
+        const Setpoints &setpoints = this->setpoints;
+
+        // with no target, or no readings to go on, both relays are off. That
+        // includes one restored from the config before a probe has read.
+        bool coolTurnOn = false;
+        if (setpoints.coolTarget().has_value() && ferm.has_value() && amb.has_value()) {
+            if (ferm > setpoints.coolTarget().value()) {
                 coolTurnOn = true;
-                if (ferm.value() < this->coolTarget.value() + 1 && !this->freezer->isOn()) coolTurnOn = false;
+                if (ferm.value() < setpoints.coolTarget().value() + 1 && !this->freezer->isOn()) coolTurnOn = false;
             }
 
-            if (this->coolMin.has_value()) {
-                if (amb.value() <= this->coolMin.value()) {
+            if (setpoints.coolMin().has_value()) {
+                if (amb.value() <= setpoints.coolMin().value()) {
                     coolTurnOn = false;
                 }
             }
+        }
 
-            if (!this->freezer->isOn() && coolTurnOn) {
-                spdlog::info("Turning freezer on");
-                this->freezer->turnOn();
-            } else if (this->freezer->isOn() && !coolTurnOn) {
-                spdlog::info("Turning freezer off");
-                this->freezer->turnOff();
-            }
-        }   
-
-        if (this->heatTarget.has_value() && ferm.has_value() && amb.has_value()) {
-            bool heatTurnOn = false;
+        if (!this->freezer->isOn() && coolTurnOn) {
+            this->freezer->turnOn();
+            this->queueLoopEvent({ LoopEvent::Kind::Relay, unixMillis(), RelayId::Cooling, true, {}, {} });
+            saveNeeded = true;
+        } else if (this->freezer->isOn() && !coolTurnOn) {
+            this->freezer->turnOff();
+            this->queueLoopEvent({ LoopEvent::Kind::Relay, unixMillis(), RelayId::Cooling, false, {}, {} });
+            saveNeeded = true;
+        }
 
-            if (ferm.value() < this->heatTarget.value()) {
+        bool heatTurnOn = false;
+        if (setpoints.heatTarget().has_value() && ferm.has_value() && amb.has_value()) {
+            if (ferm.value() < setpoints.heatTarget().value()) {
                 heatTurnOn = true;
-                if (ferm > this->heatTarget.value() - 1 && !this->heater->isOn()) heatTurnOn = false;
+                if (ferm > setpoints.heatTarget().value() - 1 && !this->heater->isOn()) heatTurnOn = false;
             }
 
-            if (this->heatMax.has_value()) {
-                if (amb.value() >= this->heatMax.value()) {
+            if (setpoints.heatMax().has_value()) {
+                if (amb.value() >= setpoints.heatMax().value()) {
                     heatTurnOn = false;
                 }
             }
+        }
 
-            if (!this->heater->isOn() && heatTurnOn) {
-                spdlog::info("Turning heater on");
-                this->heater->turnOn();
-            } else if (this->heater->isOn() && !heatTurnOn) {
-                spdlog::info("Turning heater off");
-                this->heater->turnOff();
-            }
+        if (!this->heater->isOn() && heatTurnOn) {
+            this->heater->turnOn();
+            this->queueLoopEvent({ LoopEvent::Kind::Relay, unixMillis(), RelayId::Heating, true, {}, {} });
+            saveNeeded = true;
+        } else if (this->heater->isOn() && !heatTurnOn) {
+            this->heater->turnOff();
+            this->queueLoopEvent({ LoopEvent::Kind::Relay, unixMillis(), RelayId::Heating, false, {}, {} });
+            saveNeeded = true;
         }
 
-        this->updateTime();
-        this->updateSensors();
-        this->updateRelays();
-        this->lcd.drawAll();
+        this->publishState();
+        if (saveNeeded) this->queueSaveConfig();
 
-        /* send websocket data each second*/
         time_t now = time(NULL);
-        bool didSend = false;
-        if (now-lastWSSent>=1) {
-            didSend = false;
-            nlohmann::json status;
-            status["status"] = this->buildStatusData();
-            std::string statusStr = status.dump();
-
-            for (struct mg_connection *c : this->websocketConnections) {
-                mg_websocket_write(c, MG_WEBSOCKET_OPCODE_TEXT, statusStr.c_str(), statusStr.size());
-                didSend = true;
-            }
-            if (didSend) lastWSSent = now;
+        if (now-lastRecorded>=this->options.recordInterval) {
+            this->queueLoopEvent({ LoopEvent::Kind::Temperatures, unixMillis(), RelayId::Cooling, false,
+                probeTemp(this->probes.getSensor(this->fermenter.role)), probeTemp(this->probes.getSensor(this->ambient.role)) });
+            lastRecorded = now;
         }
 
-        usleep(100 * 1000);
+        // sensors detached during this tick can go once it's over
+        this->probes.endTick();
+
+        auto work = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tick);
+        this->loopWork.record(work.count());
+
+        this->loopJitter.record(timer.wait());
     }
 
+    this->lcdThread->join();
+    this->publisherThread->join();
+
+    // woken once more to record and save whatever the last ticks queued
+    this->housekeepingRun = false;
+    this->housekeepingWake.release();
+    this->housekeepingThread->join();
+
     spdlog::info("Stopping webserver");
-    mg_stop(ctx);
+    this->statusFeed.close();
+    stopWebServer(this->ctx, this->options);
     mg_exit_library();
 
     return 0;
 }
 
-void App::updateSensors() {
-    std::optional<float> f = this->fermenter->getTempF();
-    char tempStr[128];
+// The lcd is redrawn from the published state on its own thread, so a slow
+// SPI transfer never holds up the controller.
+void App::runLcd() {
+    if (this->options.realtime) {
+        this->lcdRealtime = makeThreadRealtime("lcd", this->options.lcdPriority, this->options.lcdCpu);
+        prefaultStack();
+    }
 
-    if (!f.has_value()) {
-        sprintf(tempStr, "Fermenter:{err}");
-    } else {
-        sprintf(tempStr, "Fermenter:%3.1f\xb0", f.value());
+    // clear lcd
+    this->lcd->setRegion(0, 0, 127, 63, false);
+    this->lcd->drawAll();
+
+    this->screen->drawLogo();
+    this->lcd->drawAll();
+
+    PeriodicTimer timer(std::chrono::microseconds(LCD_PERIOD_US));
+    while (this->runLoop) {
+        ControllerState state = this->state.load();
+
+        this->screen->updateTime(time(NULL));
+        this->screen->updateSensors(state.fermenter.smoothed, state.ambient.smoothed);
+        this->screen->updateRelays(state.cooling, state.setpoints.coolTarget(), state.heating, state.setpoints.heatTarget());
+        this->screen->flush();
+
+        this->lcdJitter.record(timer.wait());
     }
-    this->lcd.setRegion(2,12, 128, 24, false);
-    this->lcd.putString(2,12, tempStr);
+}
 
-    f = this->ambient->getTempF();
-    if (!f.has_value()) {
-        sprintf(tempStr, "Ambient  :{err}");
-    } else {
-        sprintf(tempStr, "Ambient  :%3.1f\xb0", f.value());
+// Websocket writes block on slow clients and /events history allocates, so
+// the status goes out from here rather than from the control loop.
+void App::runPublisher() {
+    PeriodicTimer timer(std::chrono::seconds(1));
+    while (this->runLoop) {
+        std::string_view statusStr = this->statusWriter.writeEvent(this->state.load());
+        this->statusFeed.publish(std::string(statusStr));
+        this->websockets.broadcast(statusStr);
+
+        timer.wait();
     }
-    this->lcd.setRegion(2,24, 128, 36, false);
-    this->lcd.putString(2,24, tempStr);
 }
 
-void App::updateTime() {
-    time_t now;
-    now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-    char timeStr[26];
+void App::queueLoopEvent(const LoopEvent &event) {
+    if (!this->loopEvents.push(event)) this->loopEventsDropped.fetch_add(1, std::memory_order_relaxed);
+    this->housekeepingWake.release();
+}
 
-    strftime(timeStr, 26, "%Y-%m-%d %H:%M:%S", tm_info);
-    this->lcd.setRegion(10, 0, 128, 12, false);
-    this->lcd.putString(10, 0, timeStr);
+void App::queueSaveConfig() {
+    this->configDirty.store(true);
+    this->housekeepingWake.release();
 }
 
-void App::updateRelays() {
-    bool on = this->freezer->isOn();
+// Records, logs and saves what the control loop queued, and destroys the
+// sensors it's finished with. Runs until the loop has stopped and everything
+// it queued is done.
+void App::runHousekeeping() {
+    bool running = true;
+    while (running) {
+        this->housekeepingWake.try_acquire_for(std::chrono::milliseconds(HOUSEKEEPING_INTERVAL));
+        running = this->housekeepingRun;
+
+        LoopEvent event;
+        while (this->loopEvents.pop(event)) {
+            if (event.kind==LoopEvent::Kind::Relay) {
+                eventLog().info("Turning {} {}", event.relay==RelayId::Cooling ? "freezer" : "heater", event.on ? "on" : "off");
+                this->recorder->recordRelay(event.time, event.relay, event.on);
+            } else {
+                this->recorder->recordTemperatures(event.time, event.fermenter, event.ambient);
+            }
+        }
+
+        uint64_t dropped = this->loopEventsDropped.exchange(0);
+        if (dropped>0) spdlog::warn("Housekeeping queue full, dropped {} records", dropped);
 
-    char relayStr[128];
+        if (this->configDirty.exchange(false)) this->saveConfig();
 
-    if (this->coolTarget.has_value()) {
-        sprintf(relayStr, "Cooling:%s [%3.1f\xb0]", on ? "ON " : "OFF", this->coolTarget.value());
-    } else {
-        sprintf(relayStr, "Cooling:%s [NONE ]", on ? "ON " : "OFF");
+        this->probes.sweep();
     }
-    this->lcd.setRegion(2,36, 128, 48, false);
-    this->lcd.putString(2,36, relayStr);
+}
 
-    on = this->heater->isOn();
-    if (this->heatTarget.has_value()) {
-        sprintf(relayStr, "Heating:%s [%3.1f\xb0]", on ? "ON " : "OFF", this->heatTarget.value());
-    } else {
-        sprintf(relayStr, "Heating:%s [NONE ]", on ? "ON " : "OFF");
+void App::filterSample(Probe &probe, double now) {
+    TempSensor *sensor = this->probes.getSensor(probe.role);
+    std::optional<float> temp;
+    if (sensor!=nullptr) {
+        uint64_t count = sensor->getSampleCount();
+        if (sensor!=probe.sampled || count!=probe.samples) {
+            probe.sampled = sensor;
+            probe.samples = count;
+            temp = sensor->getTempF();
+        }
     }
-    this->lcd.setRegion(2,48, 128, 60, false);
-    this->lcd.putString(2,48, relayStr);
+
+    // a detached probe expires like one that stopped reading
+    if (temp.has_value()) probe.filter.add(now, temp.value());
+    probe.filter.expire(now, SENSOR_MAX_AGE);
 }
 
-nlohmann::json App::buildStatusData() {
-    return {
-        { "temperature", {
-            {"fermenter", VALUE_OR_NULL(this->fermenter->getTempF())},
-            {"ambient", VALUE_OR_NULL(this->ambient->getTempF())}
-        }},
-        { "thermostat", {
-            {"coolTargetTemp", VALUE_OR_NULL(this->coolTarget)},
-            {"coolMinTemp", VALUE_OR_NULL(this->coolMin)},
-            {"heatTargetTemp", VALUE_OR_NULL(this->heatTarget)},
-            {"heatMaxTemp", VALUE_OR_NULL(this->heatMax)}
-        }},
-        { "relay", {
-            {"cooling", this->freezer->isOn()},
-            {"heating", this->heater->isOn()}
-        }}
+
+void App::reportBootToControl() {
+    double uptime;
+    FILE *f = fopen("/proc/uptime", "r");
+    if (f==nullptr) return;
+    if (fscanf(f, "%lf", &uptime)==1) {
+        spdlog::info("Control loop running {:.1f}s after boot", uptime);
+        std::lock_guard<std::mutex> lock(this->startupLock);
+        this->bootToControl = uptime;
+    }
+    fclose(f);
+}
+
+bool App::applyCommands() {
+    bool changed = false;
+    Command command;
+    while (this->commands.pop(command)) {
+        std::optional<float> &value = this->setpoints.values[command.parameter];
+        std::optional<float> previous = value;
+        if (command.op==Command::Op::Set) {
+            value = command.value;
+        } else {
+            value.reset();
+        }
+        if (value!=previous) changed = true;
+    }
+    return changed;
+}
+
+void App::publishState() {
+    ControllerState next;
+    next.fermenter = {
+        probeTemp(this->probes.getSensor(this->fermenter.role)),
+        this->fermenter.filter.getSmoothed(),
+        this->fermenter.filter.getRate(),
+        this->fermenter.filter.getRejected()
     };
+    next.ambient = {
+        probeTemp(this->probes.getSensor(this->ambient.role)),
+        this->ambient.filter.getSmoothed(),
+        this->ambient.filter.getRate(),
+        this->ambient.filter.getRejected()
+    };
+    next.setpoints = this->setpoints;
+    next.cooling = this->freezer->isOn();
+    next.heating = this->heater->isOn();
+
+    this->state.store(next);
 }
 
-static std::string remoteAddressStr(const struct mg_connection *c) {
-    const char *remoteAddr = mg_get_header(c, "X-Real-IP");
-    const struct mg_request_info *req = mg_get_request_info(c);
+int App::changeSetpoint(Command::Op op, const Parameter &param, float value, std::string_view origin) {
+    if (op==Command::Op::Set && !parameterValueValid(param, value)) return 400;
 
-    if (remoteAddr==NULL) remoteAddr = req->remote_addr;
+    // logged once queued, a dropped change never happened
+    if (!this->commands.push({ op, (uint8_t)parameterIndex(param), value })) {
+        spdlog::warn("Command queue full, dropping {} of {} (from {})", op==Command::Op::Set ? "set" : "clear", param.name, origin);
+        return 503;
+    }
 
-    return std::string(remoteAddr);
+    if (op==Command::Op::Set) {
+        eventLog().info("Setting {} to {} (from {})", param.name, value, origin);
+    } else {
+        eventLog().info("Clearing {} (from {})", param.name, origin);
+    }
+    return 204;
 }
 
-static void endRequest(const struct mg_connection *c, int replyStatus) {
+int App::assignProbe(std::string_view role, std::string_view id, std::string_view origin) {
+    size_t index;
+    if (!this->probes.findRole(role, index) || !ProbeRoles::validId(id)) return 400;
+
+    eventLog().info("Assigning {} probe {} (from {})", role, id, origin);
+    if (!this->probes.assign(index, std::string(id))) spdlog::warn("{} probe {} not found in {}", role, id, this->options.w1Dir);
+
+    // written with the ids as they are now, whatever the file said
+    this->queueSaveConfig();
+    return 204;
+}
+
+void App::handleEndRequest(const struct mg_connection *c, int replyStatus) {
     if (replyStatus<0) return;
+    App *app = (App*)mg_get_user_data(mg_get_context(c));
     const struct mg_request_info *req = mg_get_request_info(c);
 
-    if (replyStatus>=400 && replyStatus <700) {
-        spdlog::warn("{} {} {} -> {}", remoteAddressStr(c), req->request_method, req->local_uri, replyStatus);
-    } else {
-        spdlog::info("{} {} {} -> {}", remoteAddressStr(c), req->request_method, req->local_uri, replyStatus);
-    }
+    app->accessLog.log(remoteAddress(c), req->request_method, req->local_uri, replyStatus);
 }
 
 int App::handleClearRequest(struct mg_connection *c, void *data) {
@@ -368,9 +605,12 @@ int App::handleClearRequest(struct mg_connection *c, void *data) {
         return 405;
     }
 
-    struct mg_match_context mcx;
+    // /clear/<name>, looked at in place
+    std::string_view path(req->local_uri);
+    std::string_view prefix("/clear/");
+    const Parameter *param = path.starts_with(prefix) ? findParameter(path.substr(prefix.size())) : nullptr;
 
-    if (mg_match("/clear/?*", req->local_uri, &mcx)==-1 || mcx.num_matches!=1) {
+    if (param==nullptr) {
         mg_printf(c, "HTTP/1.1 400 Bad Request\r\n");
         mg_printf(c, "Content-Type: text/plain\r\n");
         mg_printf(c, "Connection: close\r\n");
@@ -380,21 +620,55 @@ int App::handleClearRequest(struct mg_connection *c, void *data) {
         return 400;
     }
 
-    std::string var(mcx.match[0].str, mcx.match[0].len);
-
-    if (var=="coolTarget") {
-        spdlog::info("Clearing coolTarget (from {})", remoteAddressStr(c));
-        app->coolTarget.reset();
-    } else if (var=="coolMin") {
-        spdlog::info("Clearing coolMin (from {})", remoteAddressStr(c));
-        app->coolMin.reset();
-    } else if (var=="heatTarget") {
-        spdlog::info("Clearing heatTarget (from {})", remoteAddressStr(c));
-        app->heatTarget.reset();
-    } else if (var=="heatMax") {
-        spdlog::info("Clearing heatMax (from {})", remoteAddressStr(c));
-        app->heatMax.reset();
-    } else {
+    int status = app->changeSetpoint(Command::Op::Clear, *param, 0, remoteAddress(c));
+
+    if (status==400) {
+        mg_printf(c, "HTTP/1.1 400 Bad Request\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "400: Bad Request");
+        return 400;
+    } else if (status==503) {
+        mg_printf(c, "HTTP/1.1 503 Service Unavailable\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "503: Service Unavailable");
+        return 503;
+    }
+
+    mg_printf(c, "HTTP/1.1 204 No Content\r\n");
+    mg_printf(c, "Connection: close\r\n");
+    mg_printf(c, "\r\n");
+    return 204;
+}
+
+int App::handleProbeRequest(struct mg_connection *c, void *data) {
+    App *app = (App*)data;
+
+    const struct mg_request_info *req = mg_get_request_info(c);
+    if (std::string(req->request_method)!="POST") {
+        mg_printf(c, "HTTP/1.1 405 Method Not Allowed\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "405: Method Not Allowed");
+
+        return 405;
+    }
+
+    // /probe/<role>/<id>, looked at in place
+    std::string_view path(req->local_uri);
+    std::string_view prefix("/probe/");
+    int status = 400;
+    if (path.starts_with(prefix)) {
+        path.remove_prefix(prefix.size());
+        size_t slash = path.find('/');
+        if (slash!=std::string_view::npos) status = app->assignProbe(path.substr(0, slash), path.substr(slash + 1), remoteAddress(c));
+    }
+
+    if (status==400) {
         mg_printf(c, "HTTP/1.1 400 Bad Request\r\n");
         mg_printf(c, "Content-Type: text/plain\r\n");
         mg_printf(c, "Connection: close\r\n");
@@ -406,7 +680,6 @@ int App::handleClearRequest(struct mg_connection *c, void *data) {
     mg_printf(c, "HTTP/1.1 204 No Content\r\n");
     mg_printf(c, "Connection: close\r\n");
     mg_printf(c, "\r\n");
-    app->saveConfig();
     return 204;
 }
 
@@ -423,9 +696,19 @@ int App::handleSetRequest(struct mg_connection *c, void *data) {
 
         return 405;
     }
-    struct mg_match_context mcx;
+    // /set/<name>/<value>, looked at in place
+    std::string_view path(req->local_uri);
+    std::string_view prefix("/set/");
+    const Parameter *param = nullptr;
+    std::optional<float> value;
+    if (path.starts_with(prefix)) {
+        path.remove_prefix(prefix.size());
+        size_t slash = path.find('/');
+        if (slash!=std::string_view::npos) param = findParameter(path.substr(0, slash));
+        if (param!=nullptr) value = parseParameterValue(*param, path.substr(slash + 1));
+    }
 
-    if (mg_match("/set/?*/?*", req->local_uri, &mcx)==-1 || mcx.num_matches!=2) {
+    if (!value.has_value()) {
         mg_printf(c, "HTTP/1.1 400 Bad Request\r\n");
         mg_printf(c, "Content-Type: text/plain\r\n");
         mg_printf(c, "Connection: close\r\n");
@@ -435,48 +718,259 @@ int App::handleSetRequest(struct mg_connection *c, void *data) {
         return 400;
     }
 
-    std::string var(mcx.match[0].str, mcx.match[0].len);
-    std::string valStr(mcx.match[1].str, mcx.match[1].len);
-    float val = std::atof(valStr.c_str());
-
-    if (var=="coolTarget") {
-        spdlog::info("Setting coolTarget to {} (from {})", val, remoteAddressStr(c));
-        app->coolTarget = val;
-    } else if (var=="coolMin") {
-        spdlog::info("Setting coolMin to {} (from {})", val, remoteAddressStr(c));
-        app->coolMin = val;
-    } else if (var=="heatTarget") {
-        spdlog::info("Setting heatTarget to {} (from {})", val, remoteAddressStr(c));
-        app->heatTarget = val;
-    } else if (var=="heatMax") {
-        spdlog::info("Setting heatMax to {} (from {})", val, remoteAddressStr(c));
-        app->heatMax = val;
-    } else {
+    int status = app->changeSetpoint(Command::Op::Set, *param, value.value(), remoteAddress(c));
+
+    if (status==400) {
         mg_printf(c, "HTTP/1.1 400 Bad Request\r\n");
         mg_printf(c, "Content-Type: text/plain\r\n");
         mg_printf(c, "Connection: close\r\n");
         mg_printf(c, "\r\n");
         mg_printf(c, "400: Bad Request");
         return 400;
+    } else if (status==503) {
+        mg_printf(c, "HTTP/1.1 503 Service Unavailable\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "503: Service Unavailable");
+        return 503;
     }
 
     mg_printf(c, "HTTP/1.1 204 No Content\r\n");
     mg_printf(c, "Connection: close\r\n");
     mg_printf(c, "\r\n");
-    app->saveConfig();
     return 204;
 }
 
+int App::handleEventsRequest(struct mg_connection *c, void *data) {
+    App *app = (App*)data;
+
+    const struct mg_request_info *req = mg_get_request_info(c);
+    if (std::string(req->request_method)!="GET") {
+        mg_printf(c, "HTTP/1.1 405 Method Not Allowed\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "405: Method Not Allowed");
+
+        return 405;
+    }
+
+    if (app->eventClients.fetch_add(1) >= MAX_EVENT_CLIENTS) {
+        app->eventClients--;
+        mg_printf(c, "HTTP/1.1 503 Service Unavailable\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Retry-After: 10\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "503: Too many event stream clients");
+
+        return 503;
+    }
+
+    // resume after the client's last event, or start with the current status
+    uint64_t after = 0;
+    const char *lastEventId = mg_get_header(c, "Last-Event-ID");
+    if (lastEventId!=NULL) {
+        after = std::strtoull(lastEventId, nullptr, 10);
+    } else {
+        std::shared_ptr<const StatusEvent> latest = app->statusFeed.latest();
+        if (latest) after = latest->id - 1;
+    }
+
+    spdlog::info("{} connected to event stream (after {})", remoteAddressStr(c), after);
+
+    mg_printf(c, "HTTP/1.1 200 OK\r\n");
+    mg_printf(c, "Content-Type: text/event-stream\r\n");
+    mg_printf(c, "Cache-Control: no-cache\r\n");
+    mg_printf(c, "Transfer-Encoding: chunked\r\n");
+    mg_printf(c, "\r\n");
+
+    std::string chunk = "retry: 3000\n\n";
+    int r = mg_send_chunk(c, chunk.data(), chunk.size());
+
+    while (r>0 && app->runLoop) {
+        std::shared_ptr<const StatusEvent> ev = app->statusFeed.next(after, std::chrono::seconds(15));
+        if (ev) {
+            chunk = "id: " + std::to_string(ev->id) + "\ndata: " + ev->data + "\n\n";
+            after = ev->id;
+        } else {
+            // comment line, keeps proxies from timing out and notices dead clients
+            chunk = ":\n\n";
+        }
+        r = mg_send_chunk(c, chunk.data(), chunk.size());
+    }
+    if (r>0) mg_send_chunk(c, "", 0);
+
+    app->eventClients--;
+    spdlog::info("{} disconnected from event stream", remoteAddressStr(c));
+
+    return 200;
+}
+
+int App::handleExportRequest(struct mg_connection *c, void *data) {
+    App *app = (App*)data;
+
+    const struct mg_request_info *req = mg_get_request_info(c);
+    if (std::string(req->request_method)!="GET") {
+        mg_printf(c, "HTTP/1.1 405 Method Not Allowed\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "405: Method Not Allowed");
+
+        return 405;
+    }
+
+    // from/to are unix seconds, both optional
+    char fromStr[32], toStr[32], format[8];
+    const char *query = req->query_string ? req->query_string : "";
+    size_t queryLen = strlen(query);
+    int64_t from = 0;
+    int64_t to = INT64_MAX;
+    bool ok = true;
+
+    if (mg_get_var(query, queryLen, "from", fromStr, sizeof(fromStr))>=0) {
+        char *end;
+        errno = 0;
+        long long seconds = std::strtoll(fromStr, &end, 10);
+        ok = ok && errno==0 && end!=fromStr && *end==0 && unixSecondsValid(seconds);
+        if (ok) from = seconds * 1000;
+    }
+    if (mg_get_var(query, queryLen, "to", toStr, sizeof(toStr))>=0) {
+        char *end;
+        errno = 0;
+        long long seconds = std::strtoll(toStr, &end, 10);
+        ok = ok && errno==0 && end!=toStr && *end==0 && unixSecondsValid(seconds);
+        if (ok) to = seconds * 1000 + 999;
+    }
+    if (mg_get_var(query, queryLen, "format", format, sizeof(format))<0) strcpy(format, "csv");
+
+    bool csv = strcmp(format, "csv")==0;
+    if (!ok || (!csv && strcmp(format, "bin")!=0)) {
+        mg_printf(c, "HTTP/1.1 400 Bad Request\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "400: Bad Request");
+
+        return 400;
+    }
+
+    // the headers wait for the first chunk, until then a failure can be a 500
+    bool started = false;
+    ExportSink sink = [c, csv, &started](const char *data, size_t len) {
+        if (!started) {
+            mg_printf(c, "HTTP/1.1 200 OK\r\n");
+            if (csv) {
+                mg_printf(c, "Content-Type: text/csv\r\n");
+                mg_printf(c, "Content-Disposition: attachment; filename=\"brewserver.csv\"\r\n");
+            } else {
+                mg_printf(c, "Content-Type: application/octet-stream\r\n");
+                mg_printf(c, "Content-Disposition: attachment; filename=\"brewserver.brwx\"\r\n");
+            }
+            mg_printf(c, "Transfer-Encoding: chunked\r\n");
+            mg_printf(c, "\r\n");
+            started = true;
+        }
+        return mg_send_chunk(c, data, len) > 0;
+    };
+    bool sent = csv ? exportCsv(*app->recorder, from, to, sink) : exportColumnar(*app->recorder, from, to, sink);
+
+    if (!started) {
+        mg_printf(c, "HTTP/1.1 500 Internal Server Error\r\n");
+        mg_printf(c, "Content-Type: text/plain\r\n");
+        mg_printf(c, "Connection: close\r\n");
+        mg_printf(c, "\r\n");
+        mg_printf(c, "500: Couldn't read the record file");
+
+        return 500;
+    }
+    // otherwise a stream cut short without its last chunk tells the client
+    if (sent) mg_send_chunk(c, "", 0);
+
+    return 200;
+}
+
 int App::handleStatusRequest(struct mg_connection *c, void *data) {
     App *app = (App*)data;
-    nlohmann::json status = app->buildStatusData();
-    std::string statusStr = status.dump();
+    StatusWriter writer;
+    std::string_view statusStr = writer.write(app->state.load());
 
     mg_printf(c, "HTTP/1.1 200 OK\r\n");
     mg_printf(c, "Content-Type: application/json\r\n");
-    mg_printf(c, "Connection: close\r\n");
+    mg_printf(c, "Content-Length: %zu\r\n", statusStr.size());
+    mg_printf(c, "\r\n");
+    mg_write(c, statusStr.data(), statusStr.size());
+
+    return 200;
+}
+
+int App::handleConfigRequest(struct mg_connection *c, void *data) {
+    App *app = (App*)data;
+    StatusWriter writer;
+    std::string_view configStr = writer.writeConfig(app->state.load().setpoints);
+
+    mg_printf(c, "HTTP/1.1 200 OK\r\n");
+    mg_printf(c, "Content-Type: application/json\r\n");
+    mg_printf(c, "Content-Length: %zu\r\n", configStr.size());
+    mg_printf(c, "\r\n");
+    mg_write(c, configStr.data(), configStr.size());
+
+    return 200;
+}
+
+int App::handleMetricsRequest(struct mg_connection *c, void *data) {
+    App *app = (App*)data;
+    std::string metrics;
+
+    app->loopJitter.writePrometheus(metrics, "brewserver_loop_jitter_seconds", "Control loop wake up lateness versus its scheduled tick time");
+    app->loopWork.writePrometheus(metrics, "brewserver_loop_work_seconds", "Time spent working in each control loop tick");
+    app->lcdJitter.writePrometheus(metrics, "brewserver_lcd_jitter_seconds", "Lcd refresh wake up lateness versus its scheduled tick time");
+
+    app->accessLog.writePrometheus(metrics);
+    metrics += "# HELP brewserver_log_overrun_total Log messages dropped because the async log ring was full\n";
+    metrics += "# TYPE brewserver_log_overrun_total counter\n";
+    metrics += fmt::format("brewserver_log_overrun_total {}\n", logOverruns());
+
+    metrics += "# HELP brewserver_probe_attached Whether the probe for a role is present\n";
+    metrics += "# TYPE brewserver_probe_attached gauge\n";
+    for (size_t i=0;i<app->probes.size();i++) {
+        metrics += fmt::format("brewserver_probe_attached{{role=\"{}\",id=\"{}\"}} {}\n", app->probes.getRole(i), app->probes.getId(i), app->probes.isAttached(i) ? 1 : 0);
+    }
+
+    metrics += "# HELP brewserver_realtime Whether a thread is running SCHED_FIFO\n";
+    metrics += "# TYPE brewserver_realtime gauge\n";
+    metrics += fmt::format("brewserver_realtime{{thread=\"control\"}} {}\n", app->controlRealtime.load() ? 1 : 0);
+    metrics += fmt::format("brewserver_realtime{{thread=\"lcd\"}} {}\n", app->lcdRealtime.load() ? 1 : 0);
+
+    {
+        std::lock_guard<std::mutex> lock(app->startupLock);
+        metrics += "# HELP brewserver_startup_phase_seconds Time taken by each startup phase\n";
+        metrics += "# TYPE brewserver_startup_phase_seconds gauge\n";
+        for (auto &[phase, seconds] : app->startupTimes) {
+            metrics += fmt::format("brewserver_startup_phase_seconds{{phase=\"{}\"}} {}\n", phase, seconds);
+        }
+        if (app->bootToControl.has_value()) {
+            metrics += "# HELP brewserver_boot_to_control_seconds Time from system boot to the first control loop tick\n";
+            metrics += "# TYPE brewserver_boot_to_control_seconds gauge\n";
+            metrics += fmt::format("brewserver_boot_to_control_seconds {}\n", app->bootToControl.value());
+        }
+    }
+
+    size_t wsClients = app->websockets.size();
+    metrics += "# HELP brewserver_event_clients Connected /events clients\n";
+    metrics += "# TYPE brewserver_event_clients gauge\n";
+    metrics += "brewserver_event_clients " + std::to_string(app->eventClients.load()) + "\n";
+    metrics += "# HELP brewserver_websocket_clients Connected websocket clients\n";
+    metrics += "# TYPE brewserver_websocket_clients gauge\n";
+    metrics += "brewserver_websocket_clients " + std::to_string(wsClients) + "\n";
+
+    mg_printf(c, "HTTP/1.1 200 OK\r\n");
+    mg_printf(c, "Content-Type: text/plain; version=0.0.4\r\n");
+    mg_printf(c, "Content-Length: %zu\r\n", metrics.size());
     mg_printf(c, "\r\n");
-    mg_printf(c, "%s", statusStr.c_str());
+    mg_write(c, metrics.data(), metrics.size());
 
     return 200;
 }
@@ -485,24 +979,21 @@ void App::setupWebServer() {
     spdlog::info("Starting web server");
     mg_init_library(MG_FEATURES_WEBSOCKET);
 
-    const char *opts[] = {
-        "listening_ports", "127.0.0.1:8000",
-        "num_threads", "10",
-        "enable_websocket_ping_pong", "yes",
-        NULL, NULL
-    };
-
     struct mg_callbacks cbs;
     memset(&cbs, 0, sizeof(cbs));
-    cbs.end_request = endRequest;
-
+    cbs.end_request = &App::handleEndRequest;
 
-    this->ctx = mg_start(&cbs, (void*)this, opts);
+    this->ctx = startWebServer(&cbs, (void*)this, this->options);
 
     mg_set_websocket_handler(this->ctx, "/websocket", &App::handleWebsocketConnected, &App::handleWebsocketReady, &App::handleWebsocketData, &App::handleWebsocketClosed, (void*)this);
     mg_set_request_handler(this->ctx, "/status$", &App::handleStatusRequest, (void*)this);
     mg_set_request_handler(this->ctx, "/set/*/*$", &App::handleSetRequest, (void*)this);
     mg_set_request_handler(this->ctx, "/clear/*$", &App::handleClearRequest, (void*)this);    
+    mg_set_request_handler(this->ctx, "/config$", &App::handleConfigRequest, (void*)this);
+    mg_set_request_handler(this->ctx, "/probe/*/*$", &App::handleProbeRequest, (void*)this);
+    mg_set_request_handler(this->ctx, "/metrics$", &App::handleMetricsRequest, (void*)this);
+    mg_set_request_handler(this->ctx, "/events$", &App::handleEventsRequest, (void*)this);
+    mg_set_request_handler(this->ctx, "/export$", &App::handleExportRequest, (void*)this);
 }
 
 int App::handleWebsocketConnected(const struct mg_connection *c, void *data) {
@@ -511,16 +1002,151 @@ int App::handleWebsocketConnected(const struct mg_connection *c, void *data) {
 
 void App::handleWebsocketReady(struct mg_connection *c, void *data) {
     App *app = (App*)data;
-    app->websocketConnections.push_back(c);
+    app->websockets.add(c);
     spdlog::info("{} connected to websocket", remoteAddressStr(c));
 }
 
 int App::handleWebsocketData(struct mg_connection *c, int bits, char *data, size_t len, void *cbdata) {
+    App *app = (App*)cbdata;
+    int opcode = bits & 0x0f;
+
+    if (opcode==MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE) return 0;
+    if (opcode!=MG_WEBSOCKET_OPCODE_TEXT) return 1;
+
+    std::string reply = app->handleWebsocketRequest(c, data, len).dump();
+    mg_websocket_write(c, MG_WEBSOCKET_OPCODE_TEXT, reply.data(), reply.size());
     return 1;
 }
 
+static bool jsonUnixSeconds(const nlohmann::json &value, int64_t &seconds) {
+    // unsigned values above INT64_MAX would wrap in get<int64_t>()
+    if (value.is_number_unsigned() && value.get<uint64_t>()>(uint64_t)MAX_UNIX_SECONDS) return false;
+    seconds = value.get<int64_t>();
+    return unixSecondsValid(seconds);
+}
+
+static nlohmann::json websocketError(const nlohmann::json &id, int code, const char *message) {
+    return {
+        { "id", id },
+        { "ok", false },
+        { "error", { { "code", code }, { "message", message } } }
+    };
+}
+
+static nlohmann::json websocketReply(const nlohmann::json &id, nlohmann::json result) {
+    return {
+        { "id", id },
+        { "ok", true },
+        { "result", std::move(result) }
+    };
+}
+
+// {"id": 1, "op": "set", "args": {"name": "coolTarget", "value": 65}} gets
+// {"id": 1, "ok": true, "result": ...} or {"id": 1, "ok": false, "error": {"code": 400, "message": ...}}
+nlohmann::json App::handleWebsocketRequest(struct mg_connection *c, const char *data, size_t len) {
+    nlohmann::json request = nlohmann::json::parse(data, data + len, nullptr, false);
+    if (request.is_discarded() || !request.is_object()) return websocketError(nullptr, 400, "request isn't a JSON object");
+
+    nlohmann::json id = request.contains("id") ? request["id"] : nlohmann::json();
+    if (!id.is_number() && !id.is_string()) return websocketError(nullptr, 400, "id must be a number or string");
+    if (!request.contains("op") || !request["op"].is_string()) return websocketError(id, 400, "op must be a string");
+
+    nlohmann::json args = request.contains("args") ? request["args"] : nlohmann::json::object();
+    if (!args.is_object()) return websocketError(id, 400, "args must be an object");
+
+    std::string op = request["op"].get<std::string>();
+    std::string origin = remoteAddressStr(c) + " via websocket";
+
+    if (op=="set" || op=="clear") {
+        if (!args.contains("name") || !args["name"].is_string()) return websocketError(id, 400, "name must be a string");
+        const Parameter *param = findParameter(args["name"].get_ref<const std::string&>());
+        if (param==nullptr) return websocketError(id, 400, "unknown setpoint");
+        float value = 0;
+        if (op=="set") {
+            if (!args.contains("value") || !args["value"].is_number()) return websocketError(id, 400, "value must be a number");
+            value = args["value"].get<float>();
+        }
+
+        int status = this->changeSetpoint(op=="set" ? Command::Op::Set : Command::Op::Clear, *param, value, origin);
+        if (status==400) return websocketError(id, 400, "value out of range");
+        if (status==503) return websocketError(id, 503, "too many pending commands");
+        return websocketReply(id, nullptr);
+    }
+
+    if (op=="assign-probe") {
+        if (!args.contains("role") || !args["role"].is_string()) return websocketError(id, 400, "role must be a string");
+        if (!args.contains("id") || !args["id"].is_string()) return websocketError(id, 400, "id must be a string");
+        int status = this->assignProbe(args["role"].get_ref<const std::string&>(), args["id"].get_ref<const std::string&>(), origin);
+        if (status==400) return websocketError(id, 400, "unknown role or bad probe id");
+        return websocketReply(id, nullptr);
+    }
+
+    if (op=="subscribe") {
+        bool status = true;
+        if (args.contains("status")) {
+            if (!args["status"].is_boolean()) return websocketError(id, 400, "status must be a boolean");
+            status = args["status"].get<bool>();
+        }
+        this->websockets.subscribe(c, status);
+        return websocketReply(id, { { "status", status } });
+    }
+
+    if (op=="get-history") {
+        // unix seconds like /export, both optional
+        int64_t from = 0;
+        int64_t to = INT64_MAX;
+        size_t limit = WEBSOCKET_HISTORY_LIMIT;
+        if (args.contains("from")) {
+            if (!args["from"].is_number_integer()) return websocketError(id, 400, "from must be an integer");
+            int64_t seconds;
+            if (!jsonUnixSeconds(args["from"], seconds)) return websocketError(id, 400, "from is out of range");
+            from = seconds * 1000;
+        }
+        if (args.contains("to")) {
+            if (!args["to"].is_number_integer()) return websocketError(id, 400, "to must be an integer");
+            int64_t seconds;
+            if (!jsonUnixSeconds(args["to"], seconds)) return websocketError(id, 400, "to is out of range");
+            to = seconds * 1000 + 999;
+        }
+        if (args.contains("limit")) {
+            if (!args["limit"].is_number_unsigned()) return websocketError(id, 400, "limit must be a positive integer");
+            limit = std::min(args["limit"].get<size_t>(), (size_t)WEBSOCKET_HISTORY_LIMIT);
+        }
+
+        nlohmann::json records = nlohmann::json::array();
+        bool truncated = false;
+        bool scanned = this->recorder->scan(from, to, [&](const Record &r) {
+            if (records.size()>=limit) {
+                truncated = true;
+                return false;
+            }
+            if (r.kind==RecordKind::Temperature) {
+                records.push_back({
+                    { "time", r.time },
+                    { "event", "temperature" },
+                    { "fermenter", (r.flags & RECORD_FERMENTER) ? nlohmann::json(r.fermenter / 100.0) : nlohmann::json() },
+                    { "ambient", (r.flags & RECORD_AMBIENT) ? nlohmann::json(r.ambient / 100.0) : nlohmann::json() }
+                });
+            } else {
+                records.push_back({
+                    { "time", r.time },
+                    { "event", "relay" },
+                    { "relay", r.relay==RelayId::Cooling ? "cooling" : "heating" },
+                    { "on", r.on!=0 }
+                });
+            }
+            return true;
+        });
+        if (!scanned) return websocketError(id, 500, "couldn't read the record file");
+
+        return websocketReply(id, { { "records", std::move(records) }, { "truncated", truncated } });
+    }
+
+    return websocketError(id, 400, "unknown op");
+}
+
 void App::handleWebsocketClosed(const struct mg_connection *c, void *data) {
     App *app = (App*)data;
-    app->websocketConnections.remove((struct mg_connection *)c);
+    app->websockets.remove(c);
     spdlog::info("{} disconnected from websocket", remoteAddressStr(c));
 }
\ No newline at end of file
@@ -2,63 +2,170 @@
 #include <memory>
 #include <optional>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <semaphore>
 #include <signal.h>
 #include "st7920.h"
+#include "status_screen.h"
 #include "temp_sensor.h"
+#include "probe_roles.h"
 #include "relay.h"
+#include "sensor_filter.h"
+#include "options.h"
+#include "histogram.h"
+#include "status_feed.h"
+#include "recorder.h"
+#include "controller_state.h"
+#include "parameters.h"
+#include "status_writer.h"
+#include "command_queue.h"
+#include "seqlock.h"
+#include "access_log.h"
+#include "websocket_fanout.h"
 #include <nlohmann/json.hpp>
-#include <list>
+#include <vector>
+#include <chrono>
+#include <functional>
 #include <civetweb.h>
 
 class App {
 public:
     static int run();
-    static void init(int argc, char **argv);
+    static void init(const Options &options);
     static void cleanup();
 
 private:
-    App();
+    App(const Options &options);
     ~App();
 
     static void handleSignal(int signal, siginfo_t *info, void *ucontext);
 
-    ST7920 lcd;
+    Options options;
+
+    std::shared_ptr<ST7920> lcd;
+    std::shared_ptr<StatusScreen> screen;
+
+    std::atomic<bool> runLoop;
+
+    // owned by the control loop, everything else goes through commands and state
+    Setpoints setpoints;
+
+    CommandQueue<Command, 64> commands;
+    // written by the control loop every tick, read by everything else
+    Seqlock<ControllerState> state;
+    // the publisher's, for the status sent each second
+    StatusWriter statusWriter;
+
+    bool applyCommands();
+    void publishState();
+    // Work the control loop hands to the housekeeping thread, so it never
+    // waits on the disk or the event log.
+    struct LoopEvent {
+        enum class Kind : uint8_t { Relay, Temperatures };
+        Kind kind;
+        int64_t time;
+        RelayId relay;
+        bool on;
+        std::optional<float> fermenter;
+        std::optional<float> ambient;
+    };
+
+    CommandQueue<LoopEvent, 64> loopEvents;
+    std::atomic<bool> configDirty;
+    std::atomic<uint64_t> loopEventsDropped;
+    // released after each hand off, never blocks the control loop
+    std::counting_semaphore<> housekeepingWake;
+    std::atomic<bool> housekeepingRun;
+
+    std::shared_ptr<std::thread> housekeepingThread;
+    void queueLoopEvent(const LoopEvent &event);
+    void queueSaveConfig();
+    void runHousekeeping();
+
+    // validates and queues a setpoint change from any client, returns the
+    // http status: 204 when queued, 400 if out of range, 503 if the queue is full
+    int changeSetpoint(Command::Op op, const Parameter &param, float value, std::string_view origin);
+
+    ProbeRoles probes;
+
+    // The control loop's side of a probe role: the filter and sample tracking.
+    struct Probe {
+        size_t role;
+
+        SensorFilter filter;
+        const TempSensor *sampled;
+        uint64_t samples;
+
+        Probe(size_t role);
+    };
+
+    Probe fermenter;
+    Probe ambient;
+
+    void filterSample(Probe &probe, double now);
+    // points a role at another probe, from any client, and saves it. Returns
+    // the http status: 204 when done, 400 for an unknown role or a bad id
+    int assignProbe(std::string_view role, std::string_view id, std::string_view origin);
 
-    bool runLoop;
+    std::shared_ptr<Relay> freezer;
+    std::shared_ptr<Relay> heater;
 
-    std::optional<float> coolTarget;
-    std::optional<float> coolMin;
-    std::optional<float> heatTarget;
-    std::optional<float> heatMax;
+    bool restoreCooling;
+    bool restoreHeating;
 
-    std::shared_ptr<TempSensor> fermenter;
-    std::shared_ptr<TempSensor> ambient;
+    std::mutex startupLock;
+    std::vector<std::pair<std::string, double>> startupTimes;
+    std::optional<double> bootToControl;
 
-    std::shared_ptr<Relay> freezer;
-    std::shared_ptr<Relay> heater;
+    std::shared_ptr<Recorder> recorder;
+
+    StatusFeed statusFeed;
+    std::atomic<int> eventClients;
+
+    void startupPhase(const std::string &name, const std::function<void()> &fn);
+    void startupPhase(const std::string &name, std::chrono::steady_clock::time_point begin);
+    void reportBootToControl();
 
     std::shared_ptr<std::thread> serverThread;
 
     struct mg_context *ctx;
 
-    std::list<struct mg_connection *> websocketConnections;
+    WebsocketFanout websockets;
 
-    void updateTime();
-    void updateSensors();
-    void updateRelays();
+    AccessLog accessLog;
 
-    void setupWebServer();
+    Histogram loopJitter;
+    Histogram loopWork;
+    Histogram lcdJitter;
+
+    std::atomic<bool> controlRealtime;
+    std::atomic<bool> lcdRealtime;
+
+    std::shared_ptr<std::thread> lcdThread;
+    void runLcd();
 
-    nlohmann::json buildStatusData();
+    // sends the status to /events and websocket clients each second
+    std::shared_ptr<std::thread> publisherThread;
+    void runPublisher();
+
+    void setupWebServer();
 
+    static void handleEndRequest(const struct mg_connection *c, int replyStatus);
     static int handleStatusRequest(struct mg_connection *c, void *data);
     static int handleSetRequest(struct mg_connection *c, void *data);
     static int handleClearRequest(struct mg_connection *c, void *data);
+    static int handleConfigRequest(struct mg_connection *c, void *data);
+    static int handleProbeRequest(struct mg_connection *c, void *data);
+    static int handleMetricsRequest(struct mg_connection *c, void *data);
+    static int handleEventsRequest(struct mg_connection *c, void *data);
+    static int handleExportRequest(struct mg_connection *c, void *data);
 
     static int handleWebsocketConnected(const struct mg_connection *c, void *data);
     static void handleWebsocketReady(struct mg_connection *c, void *data);
     static int handleWebsocketData(struct mg_connection *c, int bits, char *data, size_t len, void *cbdata);
     static void handleWebsocketClosed(const struct mg_connection *c, void *data);
+    nlohmann::json handleWebsocketRequest(struct mg_connection *c, const char *data, size_t len);
 
     void saveConfig();
     void loadConfig();
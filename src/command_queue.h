@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer, single-consumer queue.
+//
+// Each cell carries a sequence number that tells producers and the consumer
+// whose turn it is, so push and pop are a couple of atomic operations and
+// never block or allocate (D. Vyukov's bounded queue). Any thread may push,
+// only one thread may pop.
+template<typename T, size_t Capacity>
+class CommandQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1))==0, "capacity must be a power of two");
+
+public:
+    CommandQueue() : enqueuePos(0), dequeuePos(0) {
+        for (size_t i=0;i<Capacity;i++) this->cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue &operator=(const CommandQueue&) = delete;
+
+    // false if the queue is full
+    bool push(const T &value) {
+        size_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = this->cells[pos & (Capacity - 1)];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff==0) {
+                if (this->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = this->enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // consumer only, false if the queue is empty
+    bool pop(T &value) {
+        Cell &cell = this->cells[this->dequeuePos & (Capacity - 1)];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(this->dequeuePos + 1) < 0) return false;
+
+        value = cell.value;
+        cell.seq.store(this->dequeuePos + Capacity, std::memory_order_release);
+        this->dequeuePos++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::array<Cell, Capacity> cells;
+
+    // producers and the consumer each get their own cache line
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) size_t dequeuePos;
+};
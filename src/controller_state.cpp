@@ -0,0 +1,25 @@
+#include "controller_state.h"
+
+std::optional<float> &Setpoints::get(const Parameter &param) {
+    return this->values[parameterIndex(param)];
+}
+
+const std::optional<float> &Setpoints::get(const Parameter &param) const {
+    return this->values[parameterIndex(param)];
+}
+
+std::optional<float> Setpoints::coolTarget() const {
+    return this->values[parameterIndex("coolTarget")];
+}
+
+std::optional<float> Setpoints::coolMin() const {
+    return this->values[parameterIndex("coolMin")];
+}
+
+std::optional<float> Setpoints::heatTarget() const {
+    return this->values[parameterIndex("heatTarget")];
+}
+
+std::optional<float> Setpoints::heatMax() const {
+    return this->values[parameterIndex("heatMax")];
+}
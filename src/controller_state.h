@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include "parameters.h"
+
+// the parameters' values, in the order of the parameters table
+struct Setpoints {
+    std::array<std::optional<float>, parameters.size()> values;
+
+    std::optional<float> &get(const Parameter &param);
+    const std::optional<float> &get(const Parameter &param) const;
+
+    // the ones the control loop and LCD go by
+    std::optional<float> coolTarget() const;
+    std::optional<float> coolMin() const;
+    std::optional<float> heatTarget() const;
+    std::optional<float> heatMax() const;
+
+    bool operator==(const Setpoints&) const = default;
+};
+
+// a change to the setpoints, submitted by the web server threads and
+// applied by the control loop
+struct Command {
+    enum class Op : uint8_t { Set, Clear };
+
+    Op op;
+    // position in the parameters table
+    uint8_t parameter;
+    float value;
+};
+
+struct SensorState {
+    std::optional<float> temp;
+    std::optional<float> smoothed;
+    std::optional<float> ratePerMinute;
+    uint64_t rejected = 0;
+
+    bool operator==(const SensorState&) const = default;
+};
+
+// Everything the status readers need, as of one control loop tick. The loop
+// publishes it every tick through a seqlock, readers always get a complete
+// copy. Kept trivially copyable for that.
+struct ControllerState {
+    SensorState fermenter;
+    SensorState ambient;
+    Setpoints setpoints;
+    bool cooling = false;
+    bool heating = false;
+
+    bool operator==(const ControllerState&) const = default;
+};
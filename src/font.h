@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Bitmap font baked in at build time by tools/fontgen
+struct BakedGlyph {
+    int8_t left;
+    int8_t top;
+    uint8_t width;
+    uint8_t rows;
+    uint8_t advance;
+    uint16_t offset; // into BakedFont::bitmaps, rows are (width+7)/8 bytes, msb first
+};
+
+struct BakedFont {
+    uint8_t height;
+    int8_t ascender;
+    const BakedGlyph *glyphs;
+    const uint8_t *bitmaps;
+};
+
+// glyph slots: 0 is the missing glyph, then printable ascii, then the degree sign
+constexpr size_t bakedGlyphCount = 1 + 95 + 1;
+
+constexpr size_t bakedGlyphIndex(unsigned long c) {
+    if (c>=32 && c<=126) return c - 31;
+    if (c==0xb0) return 96;
+    return 0;
+}
+
+constexpr unsigned long bakedGlyphChar(size_t i) {
+    if (i>=1 && i<=95) return i + 31;
+    if (i==96) return 0xb0;
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Writes a finite double the way nlohmann::json::dump() does: the shortest
+// digits that round trip as Grisu2 finds them, with a ".0" on whole numbers.
+// Needs at least 32 bytes between first and last, returns the end of what it
+// wrote. Nothing is allocated and the output isn't null terminated.
+char *grisu2ToChars(char *first, const char *last, double value);
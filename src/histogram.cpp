@@ -0,0 +1,41 @@
+#include "histogram.h"
+#include <algorithm>
+#include <spdlog/fmt/fmt.h>
+
+Histogram::Histogram()
+:total(0), sum(0), maxValue(0) {
+    for (auto &b : this->buckets) b = 0;
+}
+
+void Histogram::record(uint64_t us) {
+    size_t i = std::lower_bound(bounds.begin(), bounds.end(), us) - bounds.begin();
+    this->buckets[i].fetch_add(1, std::memory_order_relaxed);
+    this->total.fetch_add(1, std::memory_order_relaxed);
+    this->sum.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t m = this->maxValue.load(std::memory_order_relaxed);
+    while (us > m && !this->maxValue.compare_exchange_weak(m, us, std::memory_order_relaxed));
+}
+
+uint64_t Histogram::count() {
+    return this->total.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::max() {
+    return this->maxValue.load(std::memory_order_relaxed);
+}
+
+void Histogram::writePrometheus(std::string &out, const std::string &name, const std::string &help) {
+    fmt::format_to(std::back_inserter(out), "# HELP {} {}\n", name, help);
+    fmt::format_to(std::back_inserter(out), "# TYPE {} histogram\n", name);
+
+    uint64_t cumulative = 0;
+    for (size_t i=0;i<bounds.size();i++) {
+        cumulative += this->buckets[i].load(std::memory_order_relaxed);
+        fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"{}\"}} {}\n", name, bounds[i] / 1e6, cumulative);
+    }
+    cumulative += this->buckets[bounds.size()].load(std::memory_order_relaxed);
+    fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"+Inf\"}} {}\n", name, cumulative);
+    fmt::format_to(std::back_inserter(out), "{}_sum {}\n", name, this->sum.load(std::memory_order_relaxed) / 1e6);
+    fmt::format_to(std::back_inserter(out), "{}_count {}\n", name, cumulative);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Fixed-bucket latency histogram, safe to record into from one thread while
+// others read it. Bucket bounds are in microseconds.
+class Histogram {
+public:
+    static constexpr std::array<uint64_t, 16> bounds = {
+        50, 100, 250, 500,
+        1000, 2500, 5000, 10000,
+        25000, 50000, 100000, 250000,
+        500000, 1000000, 2500000, 5000000
+    };
+
+    Histogram();
+
+    void record(uint64_t us);
+
+    uint64_t count();
+    uint64_t max();
+
+    void writePrometheus(std::string &out, const std::string &name, const std::string &help);
+
+private:
+    std::array<std::atomic<uint64_t>, bounds.size() + 1> buckets;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> maxValue;
+};
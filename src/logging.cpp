@@ -0,0 +1,42 @@
+#include "logging.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <memory>
+
+// a handful of events a day, the queue only has to cover a stalled stdout
+#define EVENT_QUEUE_SIZE 1024
+
+static std::shared_ptr<spdlog::details::thread_pool> logPool;
+static std::shared_ptr<spdlog::details::thread_pool> eventPool;
+static std::shared_ptr<spdlog::logger> events;
+
+void setupLogging(size_t queueSize, spdlog::async_overflow_policy overflow) {
+    spdlog::sink_ptr sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+
+    logPool = std::make_shared<spdlog::details::thread_pool>(queueSize, 1);
+    eventPool = std::make_shared<spdlog::details::thread_pool>(EVENT_QUEUE_SIZE, 1);
+
+    std::shared_ptr<spdlog::logger> logger = std::make_shared<spdlog::async_logger>("", sink, logPool, overflow);
+    spdlog::set_default_logger(logger);
+
+    events = std::make_shared<spdlog::async_logger>("events", sink, eventPool, spdlog::async_overflow_policy::block);
+}
+
+void shutdownLogging() {
+    if (events) events->flush();
+    spdlog::default_logger_raw()->flush();
+
+    // the pools' threads drain their queues before exiting
+    spdlog::set_default_logger(std::make_shared<spdlog::logger>("", std::make_shared<spdlog::sinks::stdout_color_sink_mt>()));
+    events.reset();
+    logPool.reset();
+    eventPool.reset();
+}
+
+spdlog::logger &eventLog() {
+    if (!events) return *spdlog::default_logger_raw();
+    return *events;
+}
+
+uint64_t logOverruns() {
+    return logPool ? logPool->overrun_counter() : 0;
+}
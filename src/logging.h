@@ -0,0 +1,22 @@
+#pragma once
+#include <spdlog/spdlog.h>
+#include <spdlog/async.h>
+#include <cstddef>
+#include <cstdint>
+
+// Replaces spdlog's default logger with an async one, so a slow stdout or
+// journald never holds up the thread that logs. Messages go through a ring of
+// queueSize entries allocated here; when it's full overflow decides between
+// waiting for room and dropping the oldest message.
+void setupLogging(size_t queueSize, spdlog::async_overflow_policy overflow);
+
+// flush and stop the logging threads
+void shutdownLogging();
+
+// Relay transitions and setpoint changes. The events logger has its own queue
+// and always waits for room, so events are never dropped to make room for
+// access logs.
+spdlog::logger &eventLog();
+
+// messages dropped from the default logger's ring
+uint64_t logOverruns();
@@ -1,10 +1,22 @@
 #include "app.h"
+#include "aggregator.h"
+#include "logging.h"
 
 
 int main(int argc, char *argv[]) {
-    App::init(argc, argv);
-    int r = App::run();
-    App::cleanup();
+    Options options = Options::parse(argc, argv);
+    setupLogging(options.logQueue, options.logBlock ? spdlog::async_overflow_policy::block : spdlog::async_overflow_policy::overrun_oldest);
+
+    int r;
+    if (!options.upstreams.empty()) {
+        r = Aggregator::run(options);
+    } else {
+        App::init(options);
+        r = App::run();
+        App::cleanup();
+    }
+
+    shutdownLogging();
 
     return r;
-}
\ No newline at end of file
+}
@@ -0,0 +1,232 @@
+#include "options.h"
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <sched.h>
+
+// bigger rings than this are a typo, and a failed allocation at startup
+#define LOG_QUEUE_MAX (1024 * 1024)
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [options]\n", prog);
+    fprintf(stderr, "  --simulate          use simulated relays and lcd\n");
+    fprintf(stderr, "  --listen PORTS      civetweb listening_ports (default 127.0.0.1:8000),\n");
+    fprintf(stderr, "                      none for no tcp listener\n");
+    fprintf(stderr, "  --unix-socket PATH  also listen on a unix domain socket\n");
+    fprintf(stderr, "  --unix-socket-mode MODE\n");
+    fprintf(stderr, "                      permissions of the unix socket, octal (default 0660)\n");
+    fprintf(stderr, "  --web-threads N     web server threads, one per open connection (default 16)\n");
+    fprintf(stderr, "  --w1-dir DIR        1-wire sysfs device directory (default /sys/bus/w1/devices)\n");
+    fprintf(stderr, "  --record-file FILE  where temperatures and relay changes are recorded\n");
+    fprintf(stderr, "                      (default ~/.brewserver-record.bin)\n");
+    fprintf(stderr, "  --record-interval S seconds between recorded temperatures (default 60)\n");
+    fprintf(stderr, "  --anticipation S    seconds ahead the controller extrapolates the fermenter\n");
+    fprintf(stderr, "                      temperature from its rate of change, 0 to disable (default 60)\n");
+    fprintf(stderr, "  --realtime          run the control and lcd threads SCHED_FIFO and lock memory\n");
+    fprintf(stderr, "  --control-priority N  SCHED_FIFO priority of the control thread (default 50)\n");
+    fprintf(stderr, "  --lcd-priority N    SCHED_FIFO priority of the lcd thread (default 40)\n");
+    fprintf(stderr, "  --control-cpu N     pin the control thread to cpu N in realtime mode\n");
+    fprintf(stderr, "  --lcd-cpu N         pin the lcd thread to cpu N in realtime mode\n");
+    fprintf(stderr, "  --log-queue N       async log ring size in messages (default 8192)\n");
+    fprintf(stderr, "  --log-overflow P    when the log ring is full: overrun drops the oldest\n");
+    fprintf(stderr, "                      message, block waits for room (default overrun)\n");
+    fprintf(stderr, "  --access-log-rate N access log lines per route per second, 0 for all (default 2)\n");
+    fprintf(stderr, "  --upstream [NAME=]HOST:PORT\n");
+    fprintf(stderr, "                      aggregate this brewserver's status instead of controlling\n");
+    fprintf(stderr, "                      hardware, can be given more than once\n");
+    fprintf(stderr, "  --help              show this help\n");
+}
+
+// the whole of text, no trailing junk, within min and max
+static bool parseLong(const char *text, long min, long max, int base, long &value) {
+    char *end;
+    errno = 0;
+    long v = strtol(text, &end, base);
+    if (errno!=0 || end==text || *end!=0 || v<min || v>max) return false;
+    value = v;
+    return true;
+}
+
+static long optionLong(const char *prog, const char *option, const char *text, long min, long max, int base=10) {
+    long value;
+    if (!parseLong(text, min, max, base, value)) {
+        if (max==INT_MAX) {
+            fprintf(stderr, "%s: --%s must be a whole number of at least %ld\n", prog, option, min);
+        } else if (base==8) {
+            fprintf(stderr, "%s: --%s must be an octal mode from %lo to %lo\n", prog, option, min, max);
+        } else {
+            fprintf(stderr, "%s: --%s must be a whole number from %ld to %ld\n", prog, option, min, max);
+        }
+        exit(1);
+    }
+    return value;
+}
+
+static bool parseUpstream(const std::string &arg, std::vector<UpstreamAddress> &upstreams) {
+    UpstreamAddress upstream;
+    std::string address = arg;
+
+    size_t eq = arg.find('=');
+    if (eq!=std::string::npos) {
+        upstream.name = arg.substr(0, eq);
+        address = arg.substr(eq + 1);
+    }
+
+    size_t colon = address.rfind(':');
+    if (colon==std::string::npos || colon==0) return false;
+    upstream.host = address.substr(0, colon);
+    long port;
+    if (!parseLong(address.c_str() + colon + 1, 1, 65535, 10, port)) return false;
+    upstream.port = port;
+
+    if (upstream.name.empty()) upstream.name = address;
+    for (const UpstreamAddress &other : upstreams) {
+        if (other.name==upstream.name) return false;
+    }
+
+    upstreams.push_back(upstream);
+    return true;
+}
+
+Options Options::parse(int argc, char **argv) {
+    Options opts;
+
+    enum {
+        OPT_SIMULATE = 256,
+        OPT_LISTEN,
+        OPT_UNIX_SOCKET,
+        OPT_UNIX_SOCKET_MODE,
+        OPT_WEB_THREADS,
+        OPT_W1_DIR,
+        OPT_ANTICIPATION,
+        OPT_RECORD_FILE,
+        OPT_RECORD_INTERVAL,
+        OPT_REALTIME,
+        OPT_CONTROL_PRIORITY,
+        OPT_LCD_PRIORITY,
+        OPT_CONTROL_CPU,
+        OPT_LCD_CPU,
+        OPT_LOG_QUEUE,
+        OPT_LOG_OVERFLOW,
+        OPT_ACCESS_LOG_RATE,
+        OPT_UPSTREAM,
+        OPT_HELP
+    };
+
+    static const struct option longOpts[] = {
+        { "simulate", no_argument,       nullptr, OPT_SIMULATE },
+        { "listen",   required_argument, nullptr, OPT_LISTEN },
+        { "unix-socket", required_argument, nullptr, OPT_UNIX_SOCKET },
+        { "unix-socket-mode", required_argument, nullptr, OPT_UNIX_SOCKET_MODE },
+        { "web-threads", required_argument, nullptr, OPT_WEB_THREADS },
+        { "w1-dir",   required_argument, nullptr, OPT_W1_DIR },
+        { "anticipation", required_argument, nullptr, OPT_ANTICIPATION },
+        { "record-file", required_argument, nullptr, OPT_RECORD_FILE },
+        { "record-interval", required_argument, nullptr, OPT_RECORD_INTERVAL },
+        { "realtime", no_argument,       nullptr, OPT_REALTIME },
+        { "control-priority", required_argument, nullptr, OPT_CONTROL_PRIORITY },
+        { "lcd-priority", required_argument, nullptr, OPT_LCD_PRIORITY },
+        { "control-cpu", required_argument, nullptr, OPT_CONTROL_CPU },
+        { "lcd-cpu",  required_argument, nullptr, OPT_LCD_CPU },
+        { "log-queue", required_argument, nullptr, OPT_LOG_QUEUE },
+        { "log-overflow", required_argument, nullptr, OPT_LOG_OVERFLOW },
+        { "access-log-rate", required_argument, nullptr, OPT_ACCESS_LOG_RATE },
+        { "upstream", required_argument, nullptr, OPT_UPSTREAM },
+        { "help",     no_argument,       nullptr, OPT_HELP },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    int o;
+    while ((o = getopt_long(argc, argv, "", longOpts, nullptr))!=-1) {
+        switch (o) {
+        case OPT_SIMULATE:
+            opts.simulate = true;
+            break;
+        case OPT_LISTEN:
+            opts.listen = strcmp(optarg, "none")==0 ? "" : optarg;
+            break;
+        case OPT_UNIX_SOCKET:
+            opts.unixSocket = optarg;
+            break;
+        case OPT_UNIX_SOCKET_MODE:
+            opts.unixSocketMode = optionLong(argv[0], "unix-socket-mode", optarg, 0, 0777, 8);
+            break;
+        case OPT_WEB_THREADS:
+            opts.webThreads = optionLong(argv[0], "web-threads", optarg, 1, INT_MAX);
+            break;
+        case OPT_W1_DIR:
+            opts.w1Dir = optarg;
+            break;
+        case OPT_ANTICIPATION:
+            opts.anticipation = atof(optarg);
+            break;
+        case OPT_RECORD_FILE:
+            opts.recordFile = optarg;
+            break;
+        case OPT_RECORD_INTERVAL:
+            opts.recordInterval = optionLong(argv[0], "record-interval", optarg, 1, INT_MAX);
+            break;
+        case OPT_REALTIME:
+            opts.realtime = true;
+            break;
+        case OPT_CONTROL_PRIORITY:
+            opts.controlPriority = optionLong(argv[0], "control-priority", optarg, 1, 99);
+            break;
+        case OPT_LCD_PRIORITY:
+            opts.lcdPriority = optionLong(argv[0], "lcd-priority", optarg, 1, 99);
+            break;
+        case OPT_CONTROL_CPU:
+            opts.controlCpu = optionLong(argv[0], "control-cpu", optarg, -1, CPU_SETSIZE - 1);
+            break;
+        case OPT_LCD_CPU:
+            opts.lcdCpu = optionLong(argv[0], "lcd-cpu", optarg, -1, CPU_SETSIZE - 1);
+            break;
+        case OPT_LOG_QUEUE:
+            opts.logQueue = optionLong(argv[0], "log-queue", optarg, 1, LOG_QUEUE_MAX);
+            break;
+        case OPT_LOG_OVERFLOW:
+            if (strcmp(optarg, "block")==0) {
+                opts.logBlock = true;
+            } else if (strcmp(optarg, "overrun")==0) {
+                opts.logBlock = false;
+            } else {
+                usage(argv[0]);
+                exit(1);
+            }
+            break;
+        case OPT_ACCESS_LOG_RATE:
+            opts.accessLogRate = optionLong(argv[0], "access-log-rate", optarg, 0, INT_MAX);
+            break;
+        case OPT_UPSTREAM:
+            if (!parseUpstream(optarg, opts.upstreams)) {
+                fprintf(stderr, "%s: bad upstream '%s', expected [NAME=]HOST:PORT\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case OPT_HELP:
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    // the LCD thread reads the control state through a seqlock, and would spin
+    // forever if it preempted the control thread partway through a write
+    bool sharedCpu = opts.controlCpu<0 || opts.lcdCpu<0 || opts.controlCpu==opts.lcdCpu;
+    if (opts.realtime && sharedCpu && opts.lcdPriority>=opts.controlPriority) {
+        fprintf(stderr, "%s: --lcd-priority must be below --control-priority unless they're pinned to different CPUs\n", argv[0]);
+        exit(1);
+    }
+
+    if (opts.listen.empty() && opts.unixSocket.empty()) {
+        fprintf(stderr, "%s: --listen none needs a --unix-socket\n", argv[0]);
+        exit(1);
+    }
+
+    return opts;
+}
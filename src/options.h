@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct UpstreamAddress {
+    std::string name;
+    std::string host;
+    int port;
+};
+
+struct Options {
+    // run without the LCD, GPIO relays or SPI bus; sensors are still read from w1Dir
+    bool simulate = false;
+
+    // civetweb listening_ports, empty for no tcp listener
+    std::string listen = "127.0.0.1:8000";
+    // optional unix domain socket, e.g. for a local reverse proxy
+    std::string unixSocket;
+    int unixSocketMode = 0660;
+    // civetweb serves each connection (keep-alive, websocket, event stream)
+    // on its own thread, clients beyond this many wait to be served
+    int webThreads = 16;
+    std::string w1Dir = "/sys/bus/w1/devices";
+
+    // defaults to ~/.brewserver-record.bin
+    std::string recordFile;
+    int recordInterval = 60;
+
+    // how far ahead the controller extrapolates the fermenter temperature
+    double anticipation = 60;
+
+    // SCHED_FIFO control and lcd threads, memory locked. A cpu of -1 leaves
+    // the thread on any cpu.
+    bool realtime = false;
+    int controlPriority = 50;
+    int lcdPriority = 40;
+    int controlCpu = -1;
+    int lcdCpu = -1;
+
+    // async log ring size in messages, and whether a full ring blocks the
+    // logging thread instead of dropping the oldest message
+    size_t logQueue = 8192;
+    bool logBlock = false;
+    // access log lines per route per second, 0 logs every request
+    int accessLogRate = 2;
+
+    // brewservers to aggregate, if any are given this runs as an aggregator
+    // instead of a controller
+    std::vector<UpstreamAddress> upstreams;
+
+    static Options parse(int argc, char **argv);
+};
@@ -0,0 +1,19 @@
+#include "parameters.h"
+#include <charconv>
+#include <cmath>
+
+std::optional<float> parseParameterValue(const Parameter &param, std::string_view text) {
+    float value = 0;
+    switch (param.type) {
+    case ParameterType::Float: {
+        std::from_chars_result r = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (r.ec!=std::errc() || r.ptr!=text.data() + text.size()) return std::nullopt;
+        break;
+    }
+    }
+    return value;
+}
+
+bool parameterValueValid(const Parameter &param, float value) {
+    return std::isfinite(value) && value>=param.min && value<=param.max;
+}
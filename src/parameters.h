@@ -0,0 +1,124 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// The parameters clients can set and clear. /set, /clear, /config, /status,
+// the websocket set and clear ops and the config file are all driven by this
+// table, and Setpoints holds their values in its order, so a new parameter is
+// an entry here.
+
+enum class ParameterType : uint8_t {
+    Float
+};
+
+struct Parameter {
+    std::string_view name;
+    // its key in the /status thermostat object
+    std::string_view statusKey;
+    ParameterType type;
+    float min;
+    float max;
+    std::string_view unit;
+};
+
+// what a DS18B20 can read, a setpoint outside it could never be reached
+#define PROBE_MIN_F -67.0f
+#define PROBE_MAX_F 257.0f
+
+inline constexpr auto parameters = std::to_array<Parameter>({
+    { "coolTarget", "coolTargetTemp", ParameterType::Float, PROBE_MIN_F, PROBE_MAX_F, "\xc2\xb0" "F" },
+    { "coolMin",    "coolMinTemp",    ParameterType::Float, PROBE_MIN_F, PROBE_MAX_F, "\xc2\xb0" "F" },
+    { "heatTarget", "heatTargetTemp", ParameterType::Float, PROBE_MIN_F, PROBE_MAX_F, "\xc2\xb0" "F" },
+    { "heatMax",    "heatMaxTemp",    ParameterType::Float, PROBE_MIN_F, PROBE_MAX_F, "\xc2\xb0" "F" },
+});
+// positions are passed around as uint8_t
+static_assert(parameters.size() <= 256);
+
+constexpr size_t parameterIndex(const Parameter &param) {
+    return &param - parameters.data();
+}
+
+// the table positions sorted by status key, the order nlohmann::json wrote
+// them in and /status still does
+inline constexpr std::array<uint8_t, parameters.size()> parametersByStatusKey = []() {
+    std::array<uint8_t, parameters.size()> order;
+    for (size_t i=0;i<parameters.size();i++) {
+        size_t j = i;
+        for (;j>0 && parameters[order[j-1]].statusKey>parameters[i].statusKey;j--) order[j] = order[j-1];
+        order[j] = (uint8_t)i;
+    }
+    return order;
+}();
+
+constexpr const char *parameterTypeName(ParameterType type) {
+    switch (type) {
+    case ParameterType::Float: return "float";
+    }
+    return "";
+}
+
+// Name lookup is a perfect hash: a seed is searched for at compile time so
+// every name lands in its own slot, a lookup is one hash and one compare.
+namespace parameter_hash {
+    constexpr size_t tableSize = 8;
+    static_assert(tableSize >= parameters.size() && (tableSize & (tableSize - 1))==0);
+
+    constexpr uint32_t hash(std::string_view s, uint32_t seed) {
+        // FNV-1a
+        uint32_t h = 2166136261u ^ seed;
+        for (char c : s) {
+            h ^= (uint8_t)c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    struct Table {
+        bool found;
+        uint32_t seed;
+        std::array<int8_t, tableSize> slots;
+    };
+
+    constexpr Table build() {
+        for (uint32_t seed=0;seed<10000;seed++) {
+            Table table = { true, seed, {} };
+            for (int8_t &slot : table.slots) slot = -1;
+
+            bool ok = true;
+            for (size_t i=0;i<parameters.size() && ok;i++) {
+                int8_t &slot = table.slots[hash(parameters[i].name, seed) & (tableSize - 1)];
+                if (slot!=-1) ok = false;
+                slot = (int8_t)i;
+            }
+            if (ok) return table;
+        }
+        return { false, 0, {} };
+    }
+
+    inline constexpr Table table = build();
+    static_assert(table.found, "no perfect hash seed found, grow tableSize");
+}
+
+constexpr const Parameter *findParameter(std::string_view name) {
+    int8_t slot = parameter_hash::table.slots[parameter_hash::hash(name, parameter_hash::table.seed) & (parameter_hash::tableSize - 1)];
+    if (slot<0 || parameters[slot].name!=name) return nullptr;
+    return &parameters[slot];
+}
+
+static_assert(findParameter("coolTarget")==&parameters[0]);
+static_assert(findParameter("heatMax")==&parameters[3]);
+static_assert(findParameter("coolTargetX")==nullptr);
+
+// a parameter's table position by name, for code that uses one in particular
+consteval size_t parameterIndex(std::string_view name) {
+    const Parameter *param = findParameter(name);
+    if (param==nullptr) throw "no parameter by that name";
+    return parameterIndex(*param);
+}
+
+// strict: the whole of text has to be a number, no whitespace, no trailing junk
+std::optional<float> parseParameterValue(const Parameter &param, std::string_view text);
+// finite and within the parameter's range
+bool parameterValueValid(const Parameter &param, float value);
@@ -0,0 +1,223 @@
+#include "probe_roles.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <sys/stat.h>
+
+// reads in a row that fail, at one every 500ms, before a sensor is reattached
+#define PROBE_REATTACH_FAILURES 4
+// hex digits after the prefix, a DS18B20 has 12
+#define PROBE_MAX_DIGITS 16
+
+ProbeRoles::Role::Role(std::string role, std::string id)
+:role(role), id(id), sensor(nullptr) {
+}
+
+ProbeRoles::ProbeRoles(std::string devicesDir, int rescanInterval)
+:devicesDir(devicesDir), rescanInterval(rescanInterval), ticks(0) {
+}
+
+ProbeRoles::~ProbeRoles() {
+    // its thread attaches and retires sensors, stop it before they go
+    this->watcher.reset();
+}
+
+size_t ProbeRoles::add(std::string role, std::string id) {
+    std::lock_guard<std::mutex> lock(this->lock);
+    this->roles.emplace_back(new Role(role, id));
+    return this->roles.size() - 1;
+}
+
+void ProbeRoles::setId(size_t role, std::string id) {
+    std::lock_guard<std::mutex> lock(this->lock);
+    this->roles[role]->id = id;
+}
+
+bool ProbeRoles::attach(size_t role) {
+    std::string id = this->getId(role);
+    if (!this->present(id)) {
+        spdlog::warn("{} probe {} not found in {}", this->roles[role]->role, id, this->devicesDir);
+        return false;
+    }
+    this->attachSensor(*this->roles[role], id, false);
+    return true;
+}
+
+void ProbeRoles::watch() {
+    std::set<std::string> probes = ProbeWatcher::scan(this->devicesDir);
+    this->watcher.reset(new ProbeWatcher(this->devicesDir, probes, [this](const std::string &id, bool present) {
+        this->handleProbe(id, present);
+    }, [this]() {
+        this->check();
+    }, this->rescanInterval));
+
+    // anything that turned up after the roles were first attached, the
+    // watcher only reports changes from here
+    for (size_t i=0;i<this->size();i++) {
+        std::string id = this->getId(i);
+        if (probes.count(id)) this->handleProbe(id, true);
+    }
+}
+
+bool ProbeRoles::assign(size_t role, std::string id) {
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        Role &r = *this->roles[role];
+        if (r.id==id) return r.owner!=nullptr;
+        spdlog::info("{} probe is now {}, was {}", r.role, id, r.id);
+        this->retire(r);
+        r.id = id;
+    }
+
+    if (!this->present(id)) return false;
+    this->attachSensor(*this->roles[role], id, false);
+    return true;
+}
+
+bool ProbeRoles::validId(std::string_view id) {
+    if (!id.starts_with(probePrefix)) return false;
+    std::string_view digits = id.substr(probePrefix.size());
+    if (digits.empty() || digits.size()>PROBE_MAX_DIGITS) return false;
+    return std::all_of(digits.begin(), digits.end(), [](char c) {
+        return (c>='0' && c<='9') || (c>='a' && c<='f');
+    });
+}
+
+bool ProbeRoles::findRole(std::string_view name, size_t &role) {
+    for (size_t i=0;i<this->size();i++) {
+        if (this->roles[i]->role==name) {
+            role = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ProbeRoles::size() {
+    std::lock_guard<std::mutex> lock(this->lock);
+    return this->roles.size();
+}
+
+const std::string &ProbeRoles::getRole(size_t role) {
+    return this->roles[role]->role;
+}
+
+std::string ProbeRoles::getId(size_t role) {
+    std::lock_guard<std::mutex> lock(this->lock);
+    return this->roles[role]->id;
+}
+
+bool ProbeRoles::isAttached(size_t role) {
+    return this->roles[role]->sensor.load()!=nullptr;
+}
+
+TempSensor *ProbeRoles::getSensor(size_t role) {
+    return this->roles[role]->sensor.load();
+}
+
+void ProbeRoles::endTick() {
+    this->ticks.fetch_add(1);
+}
+
+size_t ProbeRoles::retiredCount() {
+    std::lock_guard<std::mutex> lock(this->lock);
+    return this->retired.size();
+}
+
+void ProbeRoles::handleProbe(const std::string &id, bool present) {
+    this->sweep();
+
+    Role *role = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        for (std::unique_ptr<Role> &r : this->roles) {
+            if (r->id==id) role = r.get();
+        }
+    }
+    if (role==nullptr) {
+        spdlog::info("Probe {} {}, it has no role", id, present ? "appeared" : "went away");
+        return;
+    }
+
+    if (present) {
+        this->attachSensor(*role, id, false);
+    } else {
+        spdlog::warn("{} probe {} went away", role->role, id);
+        std::lock_guard<std::mutex> lock(this->lock);
+        if (role->id==id) this->retire(*role);
+    }
+}
+
+void ProbeRoles::check() {
+    for (size_t i=0;i<this->size();i++) {
+        Role &role = *this->roles[i];
+        std::string id;
+        std::shared_ptr<TempSensor> sensor;
+        {
+            std::lock_guard<std::mutex> lock(this->lock);
+            id = role.id;
+            sensor = role.owner;
+        }
+
+        // a probe that's gone is detached by handleProbe
+        struct stat st;
+        std::string path = this->devicesDir + "/" + id + "/temperature";
+        if (stat(path.c_str(), &st)!=0) continue;
+
+        if (!sensor) {
+            this->attachSensor(role, id, false);
+        } else if (sensor->getInode()!=st.st_ino) {
+            spdlog::warn("{} probe {} has a new device node, reattaching", role.role, id);
+            this->attachSensor(role, id, true);
+        } else if (sensor->getFailures()>=PROBE_REATTACH_FAILURES) {
+            spdlog::warn("{} probe {} reads are failing, reattaching", role.role, id);
+            this->attachSensor(role, id, true);
+        }
+    }
+}
+
+bool ProbeRoles::present(const std::string &id) {
+    std::error_code ec;
+    return std::filesystem::exists(std::filesystem::path(this->devicesDir) / id, ec);
+}
+
+void ProbeRoles::attachSensor(Role &role, const std::string &id, bool replace) {
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        if (role.id!=id || (role.owner && !replace)) return;
+    }
+
+    spdlog::info("Attaching {} probe {}", role.role, id);
+    // takes the first reading, outside the lock
+    std::shared_ptr<TempSensor> sensor = std::make_shared<TempSensor>(id, this->devicesDir);
+
+    std::lock_guard<std::mutex> lock(this->lock);
+    // changed while the sensor was starting, it goes when this returns
+    if (role.id!=id || (role.owner && !replace)) return;
+    this->retire(role);
+    role.owner = sensor;
+    role.sensor.store(sensor.get());
+}
+
+// The control loop may be partway through a tick with the old pointer, so
+// it's kept until that tick is over.
+void ProbeRoles::retire(Role &role) {
+    role.sensor.store(nullptr);
+    if (role.owner) this->retired.emplace_back(this->ticks.load(), role.owner);
+    role.owner.reset();
+}
+
+void ProbeRoles::sweep() {
+    std::vector<std::pair<uint64_t, std::shared_ptr<TempSensor>>> expired;
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        uint64_t ticks = this->ticks.load();
+        std::erase_if(this->retired, [ticks, &expired](auto &retired) {
+            if (ticks <= retired.first) return false;
+            expired.push_back(std::move(retired));
+            return true;
+        });
+    }
+    // destroyed here, joining their poll threads, with the lock released
+}
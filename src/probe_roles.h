@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "probe_watcher.h"
+#include "temp_sensor.h"
+
+// The temperature probe roles (fermenter, ambient) and the sensors filling
+// them. Sensors are attached and detached as their probes come and go.
+//
+// The control loop reads each role's sensor every tick without taking a
+// lock, and calls endTick() after each tick. A detached sensor is only
+// destroyed once the tick that might still be reading it is over.
+//
+// On every rescan of the devices directory (each rescanInterval ms at most) a
+// role whose sensor keeps failing, or whose probe's device node changed, is
+// reattached. That catches a probe unplugged and plugged back in between
+// rescans, which the directory listing alone doesn't show.
+class ProbeRoles {
+public:
+    ProbeRoles(std::string devicesDir, int rescanInterval);
+    ~ProbeRoles();
+
+    ProbeRoles(const ProbeRoles&) = delete;
+    ProbeRoles &operator=(const ProbeRoles&) = delete;
+
+    // before attach() or watch(), returns the role's index
+    size_t add(std::string role, std::string id);
+    // before attach() or watch(), for the ids from the config
+    void setId(size_t role, std::string id);
+
+    // attaches the role's probe, false if it isn't there
+    bool attach(size_t role);
+    // follows probes coming and going, once the roles are first attached
+    void watch();
+
+    // points the role at another probe, retiring its sensor and attaching the
+    // new probe's if it's there. Returns whether it was.
+    bool assign(size_t role, std::string id);
+    // a DS18B20 id as the kernel names it: 28- and some lowercase hex
+    static bool validId(std::string_view id);
+    // false if there's no role called name
+    bool findRole(std::string_view name, size_t &role);
+
+    size_t size();
+    const std::string &getRole(size_t role);
+    std::string getId(size_t role);
+    bool isAttached(size_t role);
+
+    // for the control loop, good until the end of the tick it was read in
+    TempSensor *getSensor(size_t role);
+    void endTick();
+
+    // destroys the detached sensors the control loop is done with, call it
+    // regularly from a thread that can wait on their poll threads
+    void sweep();
+    // sensors detached and not yet destroyed
+    size_t retiredCount();
+
+private:
+    struct Role {
+        std::string role;
+        std::string id;
+        std::atomic<TempSensor*> sensor;
+        std::shared_ptr<TempSensor> owner;
+
+        Role(std::string role, std::string id);
+    };
+
+    std::string devicesDir;
+    int rescanInterval;
+
+    std::mutex lock;
+    std::vector<std::unique_ptr<Role>> roles;
+    std::atomic<uint64_t> ticks;
+    // with the tick count when they were detached
+    std::vector<std::pair<uint64_t, std::shared_ptr<TempSensor>>> retired;
+
+    std::shared_ptr<ProbeWatcher> watcher;
+
+    void handleProbe(const std::string &id, bool present);
+    void check();
+    bool present(const std::string &id);
+    // attaches a new sensor for id, unless the role moved on to another probe
+    // or (without replace) already has one
+    void attachSensor(Role &role, const std::string &id, bool replace);
+    // under lock
+    void retire(Role &role);
+};
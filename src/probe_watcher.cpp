@@ -0,0 +1,101 @@
+#include "probe_watcher.h"
+#include <spdlog/spdlog.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+ProbeWatcher::ProbeWatcher(std::string devicesDir, std::set<std::string> known, ProbeCallback callback, RescanCallback rescanned, int rescanInterval)
+:devicesDir(devicesDir), known(known), callback(callback), rescanned(rescanned), rescanInterval(rescanInterval), watchFd(-1) {
+    this->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->inotifyFd==-1) {
+        spdlog::error("Couldn't start inotify: ({}) {}", errno, strerror(errno));
+        throw "Couldn't start inotify";
+    }
+    this->stopFd = eventfd(0, EFD_CLOEXEC);
+    if (this->stopFd==-1) {
+        spdlog::error("Couldn't create eventfd: ({}) {}", errno, strerror(errno));
+        close(this->inotifyFd);
+        throw "Couldn't create eventfd";
+    }
+    // before returning, so nothing the caller hasn't scanned yet is missed
+    this->addWatch();
+
+    this->thread.reset(new std::thread(std::bind(&ProbeWatcher::run, this)));
+}
+
+ProbeWatcher::~ProbeWatcher() {
+    uint64_t one = 1;
+    if (write(this->stopFd, &one, sizeof(one))!=sizeof(one)) {
+        spdlog::error("Couldn't stop probe watcher: ({}) {}", errno, strerror(errno));
+    }
+    this->thread->join();
+
+    close(this->stopFd);
+    close(this->inotifyFd);
+}
+
+std::set<std::string> ProbeWatcher::scan(const std::string &devicesDir) {
+    std::set<std::string> probes;
+    std::error_code ec;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(devicesDir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.starts_with(probePrefix)) probes.insert(name);
+    }
+    return probes;
+}
+
+void ProbeWatcher::rescan() {
+    std::set<std::string> probes = ProbeWatcher::scan(this->devicesDir);
+
+    for (const std::string &id : this->known) {
+        if (!probes.count(id)) this->callback(id, false);
+    }
+    for (const std::string &id : probes) {
+        if (!this->known.count(id)) this->callback(id, true);
+    }
+
+    this->known = probes;
+
+    this->rescanned();
+}
+
+void ProbeWatcher::addWatch() {
+    this->watchFd = inotify_add_watch(this->inotifyFd, this->devicesDir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE_SELF);
+}
+
+void ProbeWatcher::run() {
+    while (true) {
+        // the directory can come and go with the w1 modules
+        if (this->watchFd==-1) this->addWatch();
+
+        struct pollfd fds[2] = {
+            { this->inotifyFd, POLLIN, 0 },
+            { this->stopFd, POLLIN, 0 }
+        };
+        int r = poll(fds, 2, this->rescanInterval);
+        if (r==-1 && errno!=EINTR) {
+            spdlog::error("Probe watcher poll failed: ({}) {}", errno, strerror(errno));
+            return;
+        }
+        if (fds[1].revents & POLLIN) return;
+
+        if (fds[0].revents & POLLIN) {
+            // only that something changed matters, the events themselves are dropped
+            alignas(struct inotify_event) char buf[4096];
+            ssize_t l;
+            while ((l = read(this->inotifyFd, buf, sizeof(buf)))>0) {
+                for (char *p=buf;p<buf+l;) {
+                    struct inotify_event *ev = (struct inotify_event*)p;
+                    if (ev->mask & (IN_IGNORED | IN_DELETE_SELF)) this->watchFd = -1;
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+        }
+
+        this->rescan();
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// what the kernel names DS18B20 probes start with, the family code
+inline constexpr std::string_view probePrefix = "28-";
+
+// Watches the 1-wire devices directory for DS18B20 probes (28-*) coming and
+// going. inotify picks up changes straight away where the directory supports
+// it; sysfs doesn't send events for devices the kernel adds, so the directory
+// is also rescanned every rescanInterval ms.
+class ProbeWatcher {
+public:
+    typedef std::function<void(const std::string &id, bool present)> ProbeCallback;
+    typedef std::function<void()> RescanCallback;
+
+    // known is what the caller already found with scan(), callback is only
+    // called for changes from there. rescanned is called after every rescan,
+    // for checks on probes that are still there. Both on the watcher's thread.
+    ProbeWatcher(std::string devicesDir, std::set<std::string> known, ProbeCallback callback, RescanCallback rescanned, int rescanInterval);
+    ~ProbeWatcher();
+
+    static std::set<std::string> scan(const std::string &devicesDir);
+
+private:
+    std::string devicesDir;
+    std::set<std::string> known;
+    ProbeCallback callback;
+    RescanCallback rescanned;
+    int rescanInterval;
+
+    int inotifyFd;
+    int watchFd;
+    // wakes the thread up to stop
+    int stopFd;
+
+    std::shared_ptr<std::thread> thread;
+
+    void addWatch();
+    void run();
+    void rescan();
+};
@@ -0,0 +1,120 @@
+#include "realtime.h"
+#include <spdlog/spdlog.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+// how much of a realtime thread's stack is faulted in up front
+#define PREFAULT_STACK_SIZE (256 * 1024)
+
+#define NSEC_PER_SEC 1000000000LL
+
+bool makeThreadRealtime(const char *name, int priority, int cpu) {
+    bool ok = true;
+
+    struct sched_param param{};
+    param.sched_priority = priority;
+    int r = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (r!=0) {
+        spdlog::warn("Couldn't make {} thread SCHED_FIFO {}: {}", name, priority, strerror(r));
+        ok = false;
+    }
+
+    if (cpu>=0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        r = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (r!=0) {
+            spdlog::warn("Couldn't pin {} thread to cpu {}: {}", name, cpu, strerror(r));
+            ok = false;
+        }
+    }
+
+    if (ok) spdlog::info("{} thread running SCHED_FIFO {}{}", name, priority, cpu>=0 ? fmt::format(" on cpu {}", cpu) : "");
+    return ok;
+}
+
+bool lockMemory(size_t heapReserve) {
+    // freed memory stays in the heap instead of going back to the kernel,
+    // and large allocations come from the heap instead of their own mmap
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    // MCL_ONFAULT: lock pages as they're touched rather than populating every
+    // mapping, the web server's thread stacks would otherwise pin megabytes each
+    if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT)!=0) {
+        spdlog::warn("Couldn't lock memory: {}", strerror(errno));
+        return false;
+    }
+
+    // fault in (and so lock) a heap reserve, then hand it back to malloc
+    char *reserve = (char*)malloc(heapReserve);
+    if (reserve!=nullptr) {
+        long page = sysconf(_SC_PAGESIZE);
+        for (size_t i=0;i<heapReserve;i+=page) reserve[i] = 0;
+        free(reserve);
+    }
+
+    spdlog::info("Memory locked, {}KiB heap reserved", heapReserve / 1024);
+    return true;
+}
+
+void prefaultStack() {
+    volatile char stack[PREFAULT_STACK_SIZE];
+    memset((char*)stack, 0, sizeof(stack));
+}
+
+PeriodicTimer::PeriodicTimer(std::chrono::microseconds period)
+:period(period.count() * 1000) {
+    clock_gettime(CLOCK_MONOTONIC, &this->next);
+}
+
+static int64_t toNanos(const struct timespec &ts) {
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+uint64_t PeriodicTimer::wait() {
+    int64_t deadline = toNanos(this->next) + this->period;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    this->next.tv_sec = deadline / NSEC_PER_SEC;
+    this->next.tv_nsec = deadline % NSEC_PER_SEC;
+    if (deadline > toNanos(now)) {
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &this->next, nullptr)==EINTR);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    // a tick more than a whole period overdue runs right away and the
+    // schedule restarts from it
+    int64_t late = toNanos(now) - deadline;
+    if (late >= this->period) this->next = now;
+    return late > 0 ? late / 1000 : 0;
+}
+
+PiMutex::PiMutex() {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    int r = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    if (r==0) r = pthread_mutex_init(&this->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (r!=0) throw "Couldn't create priority inheritance mutex";
+}
+
+PiMutex::~PiMutex() {
+    pthread_mutex_destroy(&this->mutex);
+}
+
+void PiMutex::lock() {
+    pthread_mutex_lock(&this->mutex);
+}
+
+void PiMutex::unlock() {
+    pthread_mutex_unlock(&this->mutex);
+}
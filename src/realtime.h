@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <pthread.h>
+
+// Make the calling thread SCHED_FIFO at priority and, if cpu isn't -1, pin it
+// to that cpu. Threads created afterwards by this thread inherit both, so
+// call it once the thread has started everything else it needs.
+bool makeThreadRealtime(const char *name, int priority, int cpu);
+
+// Lock the process in memory and leave glibc's heap mapped, so neither the
+// hot paths nor anything they allocate page faults once warmed up.
+bool lockMemory(size_t heapReserve);
+
+// touch the calling thread's stack so it's resident (and locked)
+void prefaultStack();
+
+// Sleeps to absolute deadlines on CLOCK_MONOTONIC, so the period doesn't
+// drift by however long each tick took. After a stall of a whole period or
+// more the schedule restarts, missed ticks aren't run back to back.
+class PeriodicTimer {
+public:
+    PeriodicTimer(std::chrono::microseconds period);
+
+    // sleep until the next tick, returns how late the wake up was in µs
+    uint64_t wait();
+
+private:
+    int64_t period;
+    struct timespec next;
+};
+
+// A mutex with priority inheritance, for state a SCHED_FIFO thread shares with
+// ordinary threads: while the realtime thread waits, whoever holds the lock
+// runs at its priority. Works with std::lock_guard.
+class PiMutex {
+public:
+    PiMutex();
+    ~PiMutex();
+
+    PiMutex(const PiMutex&) = delete;
+    PiMutex &operator=(const PiMutex&) = delete;
+
+    void lock();
+    void unlock();
+
+private:
+    pthread_mutex_t mutex;
+};
@@ -0,0 +1,117 @@
+#include "record_export.h"
+#include <spdlog/fmt/fmt.h>
+#include <array>
+#include <memory>
+#include <string>
+
+#define CSV_CHUNK_SIZE 16384
+
+bool exportCsv(Recorder &recorder, int64_t from, int64_t to, const ExportSink &sink) {
+    std::string buf;
+    buf.reserve(CSV_CHUNK_SIZE + 128);
+    buf = "time_ms,event,fermenter,ambient,relay,on\n";
+
+    bool ok = true;
+    bool scanned = recorder.scan(from, to, [&](const Record &r) {
+        if (r.kind==RecordKind::Temperature) {
+            fmt::format_to(std::back_inserter(buf), "{},temperature,", r.time);
+            if (r.flags & RECORD_FERMENTER) fmt::format_to(std::back_inserter(buf), "{:.2f}", r.fermenter / 100.0);
+            buf += ',';
+            if (r.flags & RECORD_AMBIENT) fmt::format_to(std::back_inserter(buf), "{:.2f}", r.ambient / 100.0);
+            buf += ",,\n";
+        } else {
+            fmt::format_to(std::back_inserter(buf), "{},relay,,,{},{}\n", r.time, r.relay==RelayId::Cooling ? "cooling" : "heating", r.on);
+        }
+
+        if (buf.size()>=CSV_CHUNK_SIZE) {
+            ok = sink(buf.data(), buf.size());
+            buf.clear();
+        }
+        return ok;
+    });
+    if (!scanned || !ok) return false;
+
+    if (!buf.empty()) return sink(buf.data(), buf.size());
+    return true;
+}
+
+static void putVarint(std::string &out, uint64_t v) {
+    while (v>=0x80) {
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static void putInt16(std::string &out, int16_t v) {
+    out += (char)(v & 0xff);
+    out += (char)((v >> 8) & 0xff);
+}
+
+namespace {
+struct ColumnBlock {
+    size_t count = 0;
+    std::array<int64_t, exportBlockSize> time;
+    std::array<uint8_t, exportBlockSize> kind;
+    std::array<uint8_t, exportBlockSize> relay;
+    std::array<uint8_t, exportBlockSize> flags;
+    std::array<int16_t, exportBlockSize> fermenter;
+    std::array<int16_t, exportBlockSize> ambient;
+
+    // appends the block to out
+    void encode(std::string &out) {
+        putVarint(out, this->count);
+
+        int64_t prev = 0;
+        for (size_t i=0;i<this->count;i++) {
+            putVarint(out, zigzag(this->time[i] - prev));
+            prev = this->time[i];
+        }
+        out.append((const char*)this->kind.data(), this->count);
+        out.append((const char*)this->relay.data(), this->count);
+        out.append((const char*)this->flags.data(), this->count);
+        for (size_t i=0;i<this->count;i++) putInt16(out, this->fermenter[i]);
+        for (size_t i=0;i<this->count;i++) putInt16(out, this->ambient[i]);
+
+        this->count = 0;
+    }
+};
+}
+
+bool exportColumnar(Recorder &recorder, int64_t from, int64_t to, const ExportSink &sink) {
+    std::unique_ptr<ColumnBlock> block(new ColumnBlock());
+    std::string out;
+    out.reserve(exportBlockSize * 20);
+
+    // goes out with the first block, once the file is open
+    out = "BRWX";
+    out += (char)1; // version
+
+    bool ok = true;
+    bool scanned = recorder.scan(from, to, [&](const Record &r) {
+        size_t i = block->count++;
+        block->time[i] = r.time;
+        block->kind[i] = (uint8_t)r.kind;
+        block->relay[i] = r.kind==RecordKind::Relay ? ((uint8_t)r.relay << 1) | r.on : 0;
+        block->flags[i] = r.flags;
+        block->fermenter[i] = r.fermenter;
+        block->ambient[i] = r.ambient;
+
+        if (block->count==exportBlockSize) {
+            block->encode(out);
+            ok = sink(out.data(), out.size());
+            out.clear();
+        }
+        return ok;
+    });
+    if (!scanned || !ok) return false;
+
+    if (block->count>0) block->encode(out);
+    // a zero row block ends the stream
+    putVarint(out, 0);
+    return sink(out.data(), out.size());
+}
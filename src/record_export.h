@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "recorder.h"
+
+// receives the export a chunk at a time, returns false to stop. It's first
+// called once the record file is open, so a caller can hold back its
+// response headers until then.
+typedef std::function<bool(const char *data, size_t len)> ExportSink;
+
+// false if the sink stopped it or the record file couldn't be read
+bool exportCsv(Recorder &recorder, int64_t from, int64_t to, const ExportSink &sink);
+
+// Columnar binary export, see README.md for the layout. Records are
+// encoded in blocks of up to exportBlockSize rows, one chunk per block.
+bool exportColumnar(Recorder &recorder, int64_t from, int64_t to, const ExportSink &sink);
+
+constexpr size_t exportBlockSize = 4096;
@@ -0,0 +1,104 @@
+#include "recorder.h"
+#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cmath>
+#include <string.h>
+
+Recorder::Recorder(std::string path)
+:path(path) {
+    this->fd = open(this->path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (this->fd==-1) {
+        spdlog::error("Couldn't open record file {}: ({}) {}", this->path, errno, strerror(errno));
+        throw "Couldn't open record file";
+    }
+
+    // drop a partial record left by a crash mid-write
+    off_t size = lseek(this->fd, 0, SEEK_END);
+    if (size % sizeof(Record)) {
+        spdlog::warn("Record file {} ends with a partial record, truncating", this->path);
+        if (ftruncate(this->fd, size - size % sizeof(Record))==-1) {
+            spdlog::error("Couldn't truncate record file {}: ({}) {}", this->path, errno, strerror(errno));
+        }
+    }
+
+    spdlog::info("Recording to {}", this->path);
+}
+
+Recorder::~Recorder() {
+    close(this->fd);
+}
+
+static int16_t quantize(float f) {
+    return (int16_t)std::lround(std::fmax(-32767.f, std::fmin(32767.f, f * 100.f)));
+}
+
+void Recorder::recordTemperatures(int64_t time, std::optional<float> fermenter, std::optional<float> ambient) {
+    Record r{};
+    r.time = time;
+    r.kind = RecordKind::Temperature;
+    if (fermenter.has_value()) {
+        r.flags |= RECORD_FERMENTER;
+        r.fermenter = quantize(fermenter.value());
+    }
+    if (ambient.has_value()) {
+        r.flags |= RECORD_AMBIENT;
+        r.ambient = quantize(ambient.value());
+    }
+    this->append(r);
+}
+
+void Recorder::recordRelay(int64_t time, RelayId relay, bool on) {
+    Record r{};
+    r.time = time;
+    r.kind = RecordKind::Relay;
+    r.relay = relay;
+    r.on = on ? 1 : 0;
+    this->append(r);
+}
+
+void Recorder::append(const Record &r) {
+    std::lock_guard<std::mutex> lock(this->lock);
+    if (write(this->fd, &r, sizeof(r))!=sizeof(r)) {
+        spdlog::error("Couldn't write to record file {}: ({}) {}", this->path, errno, strerror(errno));
+    }
+}
+
+bool Recorder::scan(int64_t from, int64_t to, const std::function<bool(const Record &)> &fn) {
+    int rfd = open(this->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (rfd==-1) {
+        spdlog::error("Couldn't open record file {}: ({}) {}", this->path, errno, strerror(errno));
+        return false;
+    }
+
+    // the clock can step (no RTC on a Pi, NTP fixes it up after boot), so the
+    // file isn't strictly time ordered and has to be scanned end to end
+    Record buf[256];
+    size_t have = 0;
+    bool keepGoing = true;
+    bool ok = true;
+    while (keepGoing) {
+        ssize_t r = read(rfd, (char*)buf + have, sizeof(buf) - have);
+        if (r==-1 && errno==EINTR) continue;
+        if (r==-1) {
+            spdlog::error("Couldn't read record file {}: ({}) {}", this->path, errno, strerror(errno));
+            ok = false;
+            break;
+        }
+        if (r==0) break;
+        have += r;
+
+        size_t n = have / sizeof(Record);
+        for (size_t i=0;i<n && keepGoing;i++) {
+            if (buf[i].time>=from && buf[i].time<=to) keepGoing = fn(buf[i]);
+        }
+
+        // keep a trailing partial record (still being appended) for the next read
+        size_t used = n * sizeof(Record);
+        memmove(buf, (char*)buf + used, have - used);
+        have -= used;
+    }
+
+    close(rfd);
+    return ok;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+
+enum class RecordKind : uint8_t {
+    Temperature = 0,
+    Relay = 1
+};
+
+enum class RelayId : uint8_t {
+    Cooling = 0,
+    Heating = 1
+};
+
+// one entry in the record file, 16 bytes little endian
+struct Record {
+    int64_t time;       // unix ms
+    RecordKind kind;
+    RelayId relay;      // Relay records
+    uint8_t on;         // Relay records
+    uint8_t flags;      // Temperature records, RECORD_* bits for which values are present
+    int16_t fermenter;  // hundredths of a degree F
+    int16_t ambient;
+};
+static_assert(sizeof(Record)==16);
+
+#define RECORD_FERMENTER 0x01
+#define RECORD_AMBIENT   0x02
+
+// Append-only log of temperatures and relay transitions
+class Recorder {
+public:
+    Recorder(std::string path);
+    ~Recorder();
+
+    void recordTemperatures(int64_t time, std::optional<float> fermenter, std::optional<float> ambient);
+    void recordRelay(int64_t time, RelayId relay, bool on);
+
+    // calls fn for every record with from <= time <= to, in the order they
+    // were recorded, until fn returns false. Reads in fixed size blocks.
+    // False if the file couldn't be opened or read.
+    bool scan(int64_t from, int64_t to, const std::function<bool(const Record &)> &fn);
+
+private:
+    std::string path;
+    int fd;
+    std::mutex lock;
+
+    void append(const Record &r);
+};
@@ -5,10 +5,16 @@
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <string>
+#include <string.h>
 
-Relay::Relay(uint8_t gpioChip, uint8_t gpioPin, bool activeLow)
-:activeLow(activeLow), gpioChip(gpioChip), gpioPin(gpioPin) {
-    spdlog::info("Setting up relay on GPIO {}.{}", this->gpioChip, this->gpioPin);
+Relay::Relay(uint8_t gpioChip, uint8_t gpioPin, bool activeLow, bool initialOn, bool simulated)
+:gpioChip(gpioChip), gpioPin(gpioPin), activeLow(activeLow), simulated(simulated), simulatedOn(initialOn) {
+    if (this->simulated) {
+        spdlog::info("Setting up simulated relay for GPIO {}.{} ({})", this->gpioChip, this->gpioPin, initialOn ? "on" : "off");
+        return;
+    }
+
+    spdlog::info("Setting up relay on GPIO {}.{} ({})", this->gpioChip, this->gpioPin, initialOn ? "on" : "off");
 
     std::string gpioChipPath = "/dev/gpiochip" + std::to_string(this->gpioChip);
 
@@ -19,11 +25,18 @@ Relay::Relay(uint8_t gpioChip, uint8_t gpioPin, bool activeLow)
         throw "Couldn't open GPIO chip";
     }
 
+    memset(&this->gpioReq, 0, sizeof(this->gpioReq));
     this->gpioReq.offsets[0] = this->gpioPin;
     this->gpioReq.num_lines = 1;
     this->gpioReq.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
     if (this->activeLow) this->gpioReq.config.flags |= GPIO_V2_LINE_FLAG_ACTIVE_LOW;
 
+    // drive the line to the requested state as soon as it's claimed
+    this->gpioReq.config.num_attrs = 1;
+    this->gpioReq.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    this->gpioReq.config.attrs[0].attr.values = initialOn ? 1 : 0;
+    this->gpioReq.config.attrs[0].mask = 1;
+
     int r = ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &this->gpioReq);
     if (r==-1) {
         spdlog::error("Couldn't request gpio pin {}: ({}) {}", this->gpioPin, errno, strerror(errno));
@@ -34,6 +47,7 @@ Relay::Relay(uint8_t gpioChip, uint8_t gpioPin, bool activeLow)
 }   
 
 Relay::~Relay() {
+    if (this->simulated) return;
     spdlog::info("Releasing GPIO {}.{}", this->gpioChip, this->gpioPin);
     close(this->gpioReq.fd);
 }
@@ -47,6 +61,8 @@ void Relay::turnOff() {
 }
 
 bool Relay::isOn() {
+    if (this->simulated) return this->simulatedOn;
+
     struct gpio_v2_line_values val{};
 
     val.mask = 1;
@@ -62,6 +78,11 @@ bool Relay::isOn() {
 }
 
 void Relay::set(bool on) {
+    if (this->simulated) {
+        this->simulatedOn = on;
+        return;
+    }
+
     struct gpio_v2_line_values val;
     val.mask = 1;
     val.bits = on ? 1 : 0;
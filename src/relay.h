@@ -4,7 +4,7 @@
 
 class Relay {
 public:
-    Relay(uint8_t gpioChip, uint8_t gpioPin, bool activeLow);
+    Relay(uint8_t gpioChip, uint8_t gpioPin, bool activeLow, bool initialOn=false, bool simulated=false);
     ~Relay();
 
     void turnOn();
@@ -19,4 +19,7 @@ private:
     uint8_t gpioPin;
     bool activeLow;
 
+    bool simulated;
+    bool simulatedOn;
+
 };
\ No newline at end of file
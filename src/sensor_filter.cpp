@@ -0,0 +1,135 @@
+#include "sensor_filter.h"
+#include <cmath>
+
+// a sample this far from the running median is counted as rejected
+#define OUTLIER_THRESHOLD 5.0f
+
+SensorFilter::SensorFilter(float alpha, double rateWindow)
+:alpha(alpha), rateWindow(rateWindow) {
+    this->expire(0, -1);
+    this->rejected = 0;
+}
+
+void SensorFilter::expire(double t, double maxAge) {
+    if (maxAge>=0 && t - this->lastSample <= maxAge) return;
+
+    this->recentCount = 0;
+    this->recentPos = 0;
+    this->smoothed.reset();
+    this->lastSample = 0;
+    this->rateHead = 0;
+    this->rateCount = 0;
+    this->origin = 0;
+    this->sumT = this->sumV = this->sumTT = this->sumTV = 0;
+}
+
+void SensorFilter::add(double t, float value) {
+    if (!std::isfinite(value)) {
+        this->rejected++;
+        return;
+    }
+
+    this->recent[this->recentPos] = value;
+    this->recentPos = (this->recentPos + 1) % medianSize;
+    if (this->recentCount<medianSize) this->recentCount++;
+
+    // insertion sort of at most medianSize values
+    std::array<float, medianSize> sorted;
+    for (size_t i=0;i<this->recentCount;i++) {
+        size_t j = i;
+        for (;j>0 && sorted[j-1]>this->recent[i];j--) sorted[j] = sorted[j-1];
+        sorted[j] = this->recent[i];
+    }
+    float median = sorted[(this->recentCount - 1) / 2];
+
+    if (std::fabs(value - median) > OUTLIER_THRESHOLD) this->rejected++;
+
+    if (this->smoothed.has_value()) {
+        this->smoothed = this->smoothed.value() + this->alpha * (median - this->smoothed.value());
+    } else {
+        this->smoothed = median;
+    }
+    this->lastSample = t;
+
+    this->addRate(t, this->smoothed.value());
+}
+
+void SensorFilter::addRate(double t, float v) {
+    if (this->rateCount==0) this->origin = t;
+
+    while (this->rateCount>0 && (this->rateCount==rateSize || t - (this->origin + this->rateT[this->rateHead]) > this->rateWindow)) {
+        this->popRate();
+    }
+
+    size_t i = (this->rateHead + this->rateCount) % rateSize;
+    double rt = t - this->origin;
+    this->rateT[i] = rt;
+    this->rateV[i] = v;
+    this->rateCount++;
+
+    this->sumT += rt;
+    this->sumV += v;
+    this->sumTT += rt * rt;
+    this->sumTV += rt * v;
+
+    // recompute the sums from scratch once per trip around the ring, which
+    // keeps rounding error from building up and stays O(1) amortized
+    if (i==rateSize - 1) this->rebaseRate();
+}
+
+void SensorFilter::popRate() {
+    double rt = this->rateT[this->rateHead];
+    float v = this->rateV[this->rateHead];
+
+    this->sumT -= rt;
+    this->sumV -= v;
+    this->sumTT -= rt * rt;
+    this->sumTV -= rt * v;
+
+    this->rateHead = (this->rateHead + 1) % rateSize;
+    this->rateCount--;
+}
+
+void SensorFilter::rebaseRate() {
+    double newOrigin = this->origin + this->rateT[this->rateHead];
+
+    this->sumT = this->sumV = this->sumTT = this->sumTV = 0;
+    for (size_t n=0;n<this->rateCount;n++) {
+        size_t i = (this->rateHead + n) % rateSize;
+        double rt = this->rateT[i] + this->origin - newOrigin;
+        this->rateT[i] = rt;
+        this->sumT += rt;
+        this->sumV += this->rateV[i];
+        this->sumTT += rt * rt;
+        this->sumTV += rt * this->rateV[i];
+    }
+    this->origin = newOrigin;
+}
+
+std::optional<float> SensorFilter::getSmoothed() {
+    return this->smoothed;
+}
+
+std::optional<float> SensorFilter::getRate() {
+    if (this->rateCount<2) return std::optional<float>();
+
+    double n = this->rateCount;
+    double d = n * this->sumTT - this->sumT * this->sumT;
+    if (d<=1e-9) return std::optional<float>();
+
+    double perSecond = (n * this->sumTV - this->sumT * this->sumV) / d;
+    return std::optional<float>(perSecond * 60.0);
+}
+
+std::optional<float> SensorFilter::predict(double seconds) {
+    if (!this->smoothed.has_value()) return std::optional<float>();
+
+    std::optional<float> rate = this->getRate();
+    if (!rate.has_value()) return this->smoothed;
+
+    return std::optional<float>(this->smoothed.value() + rate.value() * seconds / 60.0);
+}
+
+uint64_t SensorFilter::getRejected() {
+    return this->rejected;
+}
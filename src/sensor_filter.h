@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+// Streaming filter between a temperature sensor and the controller.
+//
+// Each sample goes through a median-of-5 (a single glitch never reaches the
+// output), then an exponential moving average. The rate of change is a least
+// squares slope over the smoothed values in a sliding time window. Everything
+// is fixed size, adding a sample never allocates.
+class SensorFilter {
+public:
+    SensorFilter(float alpha, double rateWindow);
+
+    void add(double t, float value);
+
+    // forget everything if no sample arrived within maxAge seconds
+    void expire(double t, double maxAge);
+
+    std::optional<float> getSmoothed();
+    // units per minute
+    std::optional<float> getRate();
+    // smoothed value extrapolated by the current rate
+    std::optional<float> predict(double seconds);
+
+    uint64_t getRejected();
+
+private:
+    static constexpr size_t medianSize = 5;
+    static constexpr size_t rateSize = 1024;
+
+    float alpha;
+    double rateWindow;
+
+    std::array<float, medianSize> recent;
+    size_t recentCount;
+    size_t recentPos;
+
+    std::optional<float> smoothed;
+    double lastSample;
+    uint64_t rejected;
+
+    // ring of (t, smoothed) with running least squares sums, t relative to origin
+    std::array<double, rateSize> rateT;
+    std::array<float, rateSize> rateV;
+    size_t rateHead;
+    size_t rateCount;
+    double origin;
+    double sumT, sumV, sumTT, sumTV;
+
+    void addRate(double t, float v);
+    void popRate();
+    void rebaseRate();
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single writer, many reader snapshot of a trivially copyable value.
+//
+// The writer never waits or allocates: it makes the sequence odd, stores the
+// value and makes it even again. Readers copy the value out and retry if the
+// sequence was odd or moved while they copied. The value is held in atomic
+// words so the racing copy is well defined. A reader can spin while a write
+// is in progress, so it must never be able to preempt the writer.
+template<typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable_v<T>, "Seqlock needs a trivially copyable type");
+
+public:
+    Seqlock() : seq(0) {
+        this->store(T());
+    }
+
+    Seqlock(const Seqlock&) = delete;
+    Seqlock &operator=(const Seqlock&) = delete;
+
+    // writer only
+    void store(const T &value) {
+        std::array<uint64_t, words> copy{};
+        memcpy(copy.data(), &value, sizeof(T));
+
+        uint64_t s = this->seq.load(std::memory_order_relaxed);
+        this->seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i=0;i<words;i++) this->data[i].store(copy[i], std::memory_order_relaxed);
+        this->seq.store(s + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        std::array<uint64_t, words> copy;
+        uint64_t before, after;
+        do {
+            before = this->seq.load(std::memory_order_acquire);
+            for (size_t i=0;i<words;i++) copy[i] = this->data[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = this->seq.load(std::memory_order_relaxed);
+        } while (before!=after || (before & 1));
+
+        // trivially copyable, though maybe not trivial
+        T value;
+        memcpy((void*)&value, copy.data(), sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> seq;
+    std::array<std::atomic<uint64_t>, words> data;
+};
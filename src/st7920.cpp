@@ -8,12 +8,17 @@
 #include <linux/spi/spidev.h>
 #include <cinttypes>
 #include <cstdio>
-#include <cmath>
 #include <string>
 
 #define SPEED_MHZ 1.5
 
+#ifdef BREWSERVER_FREETYPE
+#ifndef FONT_PATH
 #define FONT_PATH "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf"
+#endif
+#else
+#include "font_data.h"
+#endif
 
 ST7920::ST7920(uint8_t bus, uint8_t dev) {
     std::string path = "/dev/spidev" + std::to_string(bus) + "." + std::to_string(dev);
@@ -30,8 +35,27 @@ ST7920::ST7920(uint8_t bus, uint8_t dev) {
         throw "Couldn't set spi speed: (" + std::to_string(errno) + ") " + strerror(errno);
     }
 
+    this->init();
+}
+
+ST7920::ST7920()
+:fd(-1) {
+    this->init();
+}
+
+ST7920::~ST7920() {
+    if (this->fd!=-1) close(this->fd);
+#ifdef BREWSERVER_FREETYPE
+    FT_Done_Face(this->fontFace);
+    FT_Done_FreeType(this->ftLib);
+#endif
+}
+
+void ST7920::init() {
+    this->bytesSent = 0;
     memset(&this->pixels, 0x0, sizeof(this->pixels));
 
+#ifdef BREWSERVER_FREETYPE
     if (FT_Init_FreeType(&this->ftLib)) {
         throw "Couldn't initialize Freetype";
     }
@@ -39,21 +63,46 @@ ST7920::ST7920(uint8_t bus, uint8_t dev) {
     if (FT_New_Face(this->ftLib, FONT_PATH, 0, &this->fontFace)) {
         throw "Couldn't load font";
     }
+#endif
 
     this->setFontHeight(8);
 }
 
-ST7920::~ST7920() {
-    close(this->fd);
-    FT_Done_Face(this->fontFace);
-    FT_Done_FreeType(this->ftLib);
+uint64_t ST7920::getBytesSent() {
+    return this->bytesSent;
+}
+
+void ST7920::commandDelay() {
+    if (this->fd!=-1) usleep(75);
 }
 
 void ST7920::setFontHeight(uint8_t height) {
     this->fontHeight = height;
+#ifdef BREWSERVER_FREETYPE
     if (FT_Set_Pixel_Sizes(this->fontFace, 0, height)) {
         throw "Couldn't set font size";
     }
+
+    // the font is monospaced, every glyph advances the same as '0'
+    if (FT_Load_Char(this->fontFace, '0', FT_LOAD_DEFAULT)) {
+        throw "couldn't load glyph";
+    }
+    this->charWidth = this->fontFace->glyph->advance.x / 64;
+#else
+    this->font = nullptr;
+    for (const BakedFont &f : bakedFonts) {
+        if (f.height==height) this->font = &f;
+    }
+    if (this->font==nullptr) {
+        throw "Couldn't set font size";
+    }
+
+    this->charWidth = this->font->glyphs[bakedGlyphIndex('0')].advance;
+#endif
+}
+
+uint8_t ST7920::getCharWidth() {
+    return this->charWidth;
 }
 
 void ST7920::setFunctionSet(bool extended, bool graphicDisplay) {
@@ -66,7 +115,7 @@ void ST7920::setFunctionSet(bool extended, bool graphicDisplay) {
     }
     std::vector<uint8_t> data({ val });
     this->send(0, 0, data);
-    usleep(75);
+    this->commandDelay();
 }
 
 void ST7920::setDisplayControl(bool displayOn, bool cursorOn, bool charBlinkOn) {
@@ -76,7 +125,7 @@ void ST7920::setDisplayControl(bool displayOn, bool cursorOn, bool charBlinkOn)
     if (charBlinkOn) val |= 0b00000001;
     std::vector<uint8_t> data({ val });
     this->send(0, 0, data);
-    usleep(75);
+    this->commandDelay();
 }
 
 void ST7920::setShiftControl(bool shift, bool right) {
@@ -85,7 +134,7 @@ void ST7920::setShiftControl(bool shift, bool right) {
     if (right) val |= 0b00000100;
     std::vector<uint8_t> data{val};
     this->send(0, 0, data);
-    usleep(75);
+    this->commandDelay();
 }
 
 void ST7920::setEntryMode(bool increase, bool shift) {
@@ -94,7 +143,7 @@ void ST7920::setEntryMode(bool increase, bool shift) {
     if (shift)    val |= 0b00000001;
     std::vector<uint8_t> data{val};
     this->send(0, 0, data);
-    usleep(75);
+    this->commandDelay();
 }
 
 void ST7920::setGDRAMAddress(uint8_t row, uint8_t col) {
@@ -103,7 +152,7 @@ void ST7920::setGDRAMAddress(uint8_t row, uint8_t col) {
 
     std::vector<uint8_t> d{ rowVal, colVal };
     this->send(0, 0, d);
-    usleep(75);
+    this->commandDelay();
 }
 
 void ST7920::send(uint8_t rs, uint8_t rw, std::vector<uint8_t> data) {
@@ -114,7 +163,8 @@ void ST7920::send(uint8_t rs, uint8_t rw, std::vector<uint8_t> data) {
         sendData.push_back((byte & 0x0f) << 4);
     }
 
-    write(this->fd, sendData.data(), sendData.size());
+    this->bytesSent += sendData.size();
+    if (this->fd!=-1) write(this->fd, sendData.data(), sendData.size());
 }
 
 void ST7920::setPixel(uint8_t x, uint8_t y, bool on) {
@@ -174,11 +224,34 @@ void ST7920::drawRow(uint8_t r) {
     this->send(1, 0, data);
 }
 
+void ST7920::drawRegion(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+    if (x2>=128) x2 = 127;
+    if (y2>=64) y2 = 63;
+
+    uint8_t c1 = x1 / 16;
+    uint8_t c2 = x2 / 16;
+    std::vector<uint8_t> data;
+    data.reserve((c2 - c1 + 1) * 2);
+    for (int r=y1;r<=y2;r++) {
+        uint8_t actualR = r % 32;
+        uint8_t c = r >= 32 ? 8 : 0;
+        data.clear();
+        for (int i=c1;i<=c2;i++) {
+            uint16_t sec = this->pixels[actualR][c+i];
+            data.push_back((sec & 0xFF00) >> 8);
+            data.push_back(sec & 0x00ff);
+        }
+        this->setGDRAMAddress(actualR, c+c1);
+        this->send(1, 0, data);
+    }
+}
+
 void ST7920::drawAll() {
     for (int i=0;i<64;i++) this->drawRow(i);
 }
 
-void ST7920::putChar(uint8_t x, uint8_t y, unsigned long c) {
+#ifdef BREWSERVER_FREETYPE
+uint8_t ST7920::putChar(uint8_t x, uint8_t y, unsigned long c) {
     if (FT_Load_Char(this->fontFace, c, FT_LOAD_RENDER | FT_LOAD_TARGET_MONO | FT_LOAD_MONOCHROME)) {
         throw "couldn't load glyph";
     }
@@ -200,12 +273,32 @@ void ST7920::putChar(uint8_t x, uint8_t y, unsigned long c) {
             if(v) this->setPixel(x + xa + xOffset, topY + r, v );
         }
     }
+
+    return this->fontFace->glyph->advance.x / 64;
+}
+#else
+uint8_t ST7920::putChar(uint8_t x, uint8_t y, unsigned long c) {
+    const BakedGlyph &g = this->font->glyphs[bakedGlyphIndex(c)];
+    const uint8_t *bitmap = this->font->bitmaps + g.offset;
+    int pitch = (g.width + 7) / 8;
+
+    int baselineY = this->font->ascender + y;
+    int topY = baselineY - g.top;
+
+    for (int r=0 ; r < g.rows ; r++) {
+        for (int xa=0 ; xa < g.width; xa++) {
+            uint8_t v = (bitmap[r * pitch + xa / 8] >> (7 - (xa % 8))) & 0x01;
+            if(v) this->setPixel(x + xa + g.left, topY + r, v );
+        }
+    }
+
+    return g.advance;
 }
+#endif
 
 void ST7920::putString(uint8_t x, uint8_t y, std::string str) {
     for (char c : str) {
-        this->putChar(x, y, c);
-        x += std::ceil(this->fontFace->glyph->advance.x / 64);
+        x += this->putChar(x, y, (unsigned char)c);
         if (x>=128) return;
     }
 }
@@ -3,12 +3,18 @@
 #include <vector>
 #include <string>
 
+#ifdef BREWSERVER_FREETYPE
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#else
+#include "font.h"
+#endif
 
 class ST7920 {
 public:
     ST7920(uint8_t bus, uint8_t dev);
+    // no panel attached, all SPI output is discarded
+    ST7920();
     ~ST7920();
 
     void setFunctionSet(bool extended, bool graphicDisplay);
@@ -22,7 +28,8 @@ public:
     void setPixel(uint8_t x, uint8_t y, bool on);
     void setRegion(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, bool on);
 
-    void putChar(uint8_t x, uint8_t y, unsigned long c);
+    // returns the horizontal advance
+    uint8_t putChar(uint8_t x, uint8_t y, unsigned long c);
     void putString(uint8_t x, uint8_t y, std::string str);
 
     void putBitmap(uint8_t x, uint8_t y, uint8_t width, uint8_t *data, size_t len);
@@ -30,17 +37,30 @@ public:
     void drawSectionsForBB(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
     void drawSection(uint8_t r, uint8_t c);
     void drawRow(uint8_t r);
+    void drawRegion(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
     void drawAll();
 
     void setFontHeight(uint8_t height);
+    uint8_t getCharWidth();
+
+    uint64_t getBytesSent();
 
 private:
     int fd;
+    uint64_t bytesSent;
+
+    void init();
+    void commandDelay();
 
+#ifdef BREWSERVER_FREETYPE
     FT_Library ftLib;
     FT_Face fontFace;
+#else
+    const BakedFont *font;
+#endif
 
     uint8_t fontHeight;
+    uint8_t charWidth;
 
     uint16_t pixels[32][16];
 };
\ No newline at end of file
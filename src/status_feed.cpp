@@ -0,0 +1,51 @@
+#include "status_feed.h"
+
+StatusFeed::StatusFeed(size_t history)
+:events(history), lastId(0), closed(false) {
+}
+
+uint64_t StatusFeed::publish(std::string data) {
+    std::shared_ptr<StatusEvent> ev(new StatusEvent());
+    ev->data = std::move(data);
+
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        ev->id = ++this->lastId;
+        this->events[ev->id % this->events.size()] = ev;
+    }
+    this->published.notify_all();
+
+    return ev->id;
+}
+
+std::shared_ptr<const StatusEvent> StatusFeed::next(uint64_t after, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(this->lock);
+
+    // ids start over when the server restarts, one from further ahead than
+    // we are was from a previous run: resume from the newest snapshot
+    if (after>this->lastId) after = this->lastId>0 ? this->lastId - 1 : 0;
+
+    if (!this->published.wait_for(lock, timeout, [&]() { return this->closed || this->lastId>after; })) {
+        return nullptr;
+    }
+    if (this->closed) return nullptr;
+
+    uint64_t oldest = this->lastId >= this->events.size() ? this->lastId - this->events.size() + 1 : 1;
+    uint64_t id = after + 1 < oldest ? oldest : after + 1;
+
+    return this->events[id % this->events.size()];
+}
+
+std::shared_ptr<const StatusEvent> StatusFeed::latest() {
+    std::lock_guard<std::mutex> lock(this->lock);
+    if (this->lastId==0) return nullptr;
+    return this->events[this->lastId % this->events.size()];
+}
+
+void StatusFeed::close() {
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        this->closed = true;
+    }
+    this->published.notify_all();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct StatusEvent {
+    uint64_t id;
+    std::string data;
+};
+
+// Status snapshots published by the control loop and read by any number of
+// streaming clients. The last few snapshots are kept so a client that
+// reconnects or falls behind can resume from an event id; each client only
+// holds its own position, so a slow one never holds up the publisher.
+class StatusFeed {
+public:
+    StatusFeed(size_t history);
+
+    uint64_t publish(std::string data);
+
+    // the first retained event after `after`, waiting up to timeout for one.
+    // If `after` is older than the history the oldest retained event is returned,
+    // if it's newer than anything published (an id from before a restart) the
+    // newest one is.
+    std::shared_ptr<const StatusEvent> next(uint64_t after, std::chrono::milliseconds timeout);
+    std::shared_ptr<const StatusEvent> latest();
+
+    // wakes up all waiting readers, next() returns nothing from then on
+    void close();
+
+private:
+    std::mutex lock;
+    std::condition_variable published;
+
+    std::vector<std::shared_ptr<const StatusEvent>> events;
+    uint64_t lastId;
+    bool closed;
+};
@@ -0,0 +1,83 @@
+#include "status_screen.h"
+#include <cstdio>
+
+static uint8_t logo[] = {
+    0b00010100, 
+    0b00111111, 
+    0b00111111, 
+    0b00111011, 
+    0b00100011, 
+    0b11100001, 
+    0b10100001, 
+    0b10100001, 
+    0b10100001, 
+    0b11100001, 
+    0b00100001, 
+    0b00111111, 
+};
+
+StatusScreen::StatusScreen(std::shared_ptr<ST7920> lcd)
+:lcd(lcd),
+ clock(10, 0, 12),
+ fermenter(2, 12, 12),
+ ambient(2, 24, 12),
+ cooling(2, 36, 12),
+ heating(2, 48, 12) {
+}
+
+void StatusScreen::drawLogo() {
+    this->lcd->putBitmap(0, 0, 8, logo, 12);
+}
+
+void StatusScreen::updateSensors(std::optional<float> fermenter, std::optional<float> ambient) {
+    char tempStr[128];
+
+    if (!fermenter.has_value()) {
+        sprintf(tempStr, "Fermenter:{err}");
+    } else {
+        sprintf(tempStr, "Fermenter:%3.1f\xb0", fermenter.value());
+    }
+    this->fermenter.update(*this->lcd, tempStr);
+
+    if (!ambient.has_value()) {
+        sprintf(tempStr, "Ambient  :{err}");
+    } else {
+        sprintf(tempStr, "Ambient  :%3.1f\xb0", ambient.value());
+    }
+    this->ambient.update(*this->lcd, tempStr);
+}
+
+void StatusScreen::updateTime(time_t now) {
+    struct tm *tm_info = localtime(&now);
+    char timeStr[26];
+
+    strftime(timeStr, 26, "%Y-%m-%d %H:%M:%S", tm_info);
+    this->clock.update(*this->lcd, timeStr);
+}
+
+void StatusScreen::updateRelays(bool cooling, std::optional<float> coolTarget, bool heating, std::optional<float> heatTarget) {
+    char relayStr[128];
+
+    if (coolTarget.has_value()) {
+        sprintf(relayStr, "Cooling:%s [%3.1f\xb0]", cooling ? "ON " : "OFF", coolTarget.value());
+    } else {
+        sprintf(relayStr, "Cooling:%s [NONE ]", cooling ? "ON " : "OFF");
+    }
+    this->cooling.update(*this->lcd, relayStr);
+
+    if (heatTarget.has_value()) {
+        sprintf(relayStr, "Heating:%s [%3.1f\xb0]", heating ? "ON " : "OFF", heatTarget.value());
+    } else {
+        sprintf(relayStr, "Heating:%s [NONE ]", heating ? "ON " : "OFF");
+    }
+    this->heating.update(*this->lcd, relayStr);
+}
+
+void StatusScreen::flush() {
+    for (TextField *f : { &this->clock, &this->fermenter, &this->ambient, &this->cooling, &this->heating }) {
+        if (!f->isDirty()) continue;
+        Rect r = f->getDirty();
+        this->lcd->drawRegion(r.x1, r.y1, r.x2, r.y2);
+        f->clearDirty();
+    }
+}
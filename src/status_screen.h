@@ -0,0 +1,30 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <ctime>
+#include "st7920.h"
+#include "text_field.h"
+
+// Layout of the status page shown on the lcd
+class StatusScreen {
+public:
+    StatusScreen(std::shared_ptr<ST7920> lcd);
+
+    void drawLogo();
+
+    void updateTime(time_t now);
+    void updateSensors(std::optional<float> fermenter, std::optional<float> ambient);
+    void updateRelays(bool cooling, std::optional<float> coolTarget, bool heating, std::optional<float> heatTarget);
+
+    // sends only the parts of the screen that changed since the last flush
+    void flush();
+
+private:
+    std::shared_ptr<ST7920> lcd;
+
+    TextField clock;
+    TextField fermenter;
+    TextField ambient;
+    TextField cooling;
+    TextField heating;
+};
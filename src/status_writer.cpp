@@ -0,0 +1,147 @@
+#include "status_writer.h"
+#include "parameters.h"
+#include "grisu2.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+StatusWriter::StatusWriter()
+:pos(nullptr) {
+}
+
+std::string_view StatusWriter::write(const ControllerState &state) {
+    this->pos = this->buffer.data();
+    this->putStatus(state);
+    return std::string_view(this->buffer.data(), this->pos - this->buffer.data());
+}
+
+std::string_view StatusWriter::writeEvent(const ControllerState &state) {
+    this->pos = this->buffer.data();
+    this->put("{");
+    this->putKey("status");
+    this->putStatus(state);
+    this->put("}");
+    return std::string_view(this->buffer.data(), this->pos - this->buffer.data());
+}
+
+std::string_view StatusWriter::writeConfig(const Setpoints &setpoints) {
+    // names and units plus three floats a parameter
+    static_assert(parameters.size() * 192 <= bufferSize, "grow StatusWriter::bufferSize");
+
+    this->pos = this->buffer.data();
+    this->put("{");
+    for (const Parameter &param : parameters) {
+        if (&param!=&parameters[0]) this->put(",");
+        this->putKey(param.name);
+        this->put("{");
+        this->putKey("max");
+        this->putFloat(param.max);
+        this->put(",");
+        this->putKey("min");
+        this->putFloat(param.min);
+        this->put(",");
+        this->putKey("type");
+        this->putString(parameterTypeName(param.type));
+        this->put(",");
+        this->putKey("unit");
+        this->putString(param.unit);
+        this->put(",");
+        this->putKey("value");
+        this->putFloat(setpoints.get(param));
+        this->put("}");
+    }
+    this->put("}");
+    return std::string_view(this->buffer.data(), this->pos - this->buffer.data());
+}
+
+void StatusWriter::putStatus(const ControllerState &state) {
+    // keys in the order nlohmann sorts them
+    this->put("{");
+    this->putKey("relay");
+    this->put("{");
+    this->putKey("cooling");
+    this->putBool(state.cooling);
+    this->put(",");
+    this->putKey("heating");
+    this->putBool(state.heating);
+    this->put("},");
+
+    this->putKey("temperature");
+    this->put("{");
+    this->putKey("ambient");
+    this->putFloat(state.ambient.temp);
+    this->put(",");
+    this->putKey("fermenter");
+    this->putFloat(state.fermenter.temp);
+    this->put("},");
+
+    this->putKey("thermostat");
+    this->put("{");
+    for (uint8_t i : parametersByStatusKey) {
+        if (i!=parametersByStatusKey[0]) this->put(",");
+        this->putKey(parameters[i].statusKey);
+        this->putFloat(state.setpoints.values[i]);
+    }
+    this->put("},");
+
+    this->putKey("trend");
+    this->put("{");
+    this->putKey("ambient");
+    this->putSensorTrend(state.ambient);
+    this->put(",");
+    this->putKey("fermenter");
+    this->putSensorTrend(state.fermenter);
+    this->put("}}");
+}
+
+void StatusWriter::putSensorTrend(const SensorState &sensor) {
+    this->put("{");
+    this->putKey("ratePerMinute");
+    this->putFloat(sensor.ratePerMinute);
+    this->put(",");
+    this->putKey("rejected");
+    this->putUInt(sensor.rejected);
+    this->put(",");
+    this->putKey("smoothed");
+    this->putFloat(sensor.smoothed);
+    this->put("}");
+}
+
+void StatusWriter::put(std::string_view s) {
+    memcpy(this->pos, s.data(), s.size());
+    this->pos += s.size();
+}
+
+void StatusWriter::putKey(std::string_view key) {
+    *this->pos++ = '"';
+    this->put(key);
+    *this->pos++ = '"';
+    *this->pos++ = ':';
+}
+
+// only for our own strings, nothing is escaped
+void StatusWriter::putString(std::string_view s) {
+    *this->pos++ = '"';
+    this->put(s);
+    *this->pos++ = '"';
+}
+
+void StatusWriter::putBool(bool value) {
+    this->put(value ? "true" : "false");
+}
+
+void StatusWriter::putUInt(uint64_t value) {
+    this->pos = std::to_chars(this->pos, this->buffer.data() + this->buffer.size(), value).ptr;
+}
+
+void StatusWriter::putFloat(std::optional<float> value) {
+    if (!value.has_value() || !std::isfinite(value.value())) {
+        this->put("null");
+        return;
+    }
+
+    // std::to_chars gives the shortest digits, nlohmann's grisu2 sometimes
+    // gives different (still round trip) ones, so use a copy of nlohmann's
+    // formatting to stay byte compatible
+    this->pos = grisu2ToChars(this->pos, this->buffer.data() + this->buffer.size(), (double)value.value());
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include "controller_state.h"
+
+// Writes the status document (and /config) straight into a fixed buffer,
+// without building a json tree. The output is byte for byte what nlohmann::json::dump() gave
+// for the same document: keys in sorted order, floats widened to double and
+// formatted the same way, null for missing values.
+//
+// The returned view points into the writer and is good until the next write.
+class StatusWriter {
+public:
+    StatusWriter();
+
+    // the status object, as served by /status
+    std::string_view write(const ControllerState &state);
+    // {"status":{...}}, as published to /events and websockets
+    std::string_view writeEvent(const ControllerState &state);
+    // every parameter with its type, range, unit and value, as served by /config
+    std::string_view writeConfig(const Setpoints &setpoints);
+
+    // fixed keys plus the longest possible value for every field
+    static constexpr size_t bufferSize = 1024;
+
+private:
+    std::array<char, bufferSize> buffer;
+    char *pos;
+
+    void putStatus(const ControllerState &state);
+    void putSensorTrend(const SensorState &sensor);
+
+    void put(std::string_view s);
+    void putKey(std::string_view key);
+    void putString(std::string_view s);
+    void putBool(bool value);
+    void putUInt(uint64_t value);
+    void putFloat(std::optional<float> value);
+};
@@ -1,15 +1,22 @@
 #include "temp_sensor.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <functional>
 #include <cstdlib>
 #include <spdlog/spdlog.h>
 
-TempSensor::TempSensor(std::string id) {
+TempSensor::TempSensor(std::string id, std::string devicesDir)
+:inode(0), lastTempTime(0), sampleCount(0), failures(0) {
     this->id = id;
     spdlog::info("New temp sensor for {}", id);
-    std::string path = "/sys/bus/w1/devices/"+id+"/temperature";
+    std::string path = devicesDir+"/"+id+"/temperature";
     this->fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (this->fd!=-1 && fstat(this->fd, &st)==0) this->inode = st.st_ino;
+
+    // take the first reading before returning so the controller never starts blind
+    this->poll();
 
     this->runPoll = true;
 
@@ -23,10 +30,12 @@ TempSensor::~TempSensor() {
 }
 
 std::optional<float> TempSensor::getTempC() {
+    std::lock_guard<PiMutex> lock(this->lock);
     return this->lastTemp;
 }
 
 std::optional<float> TempSensor::getTempF() {
+    std::lock_guard<PiMutex> lock(this->lock);
     if (this->lastTemp.has_value()) {
         return std::optional<float>(this->lastTemp.value() * 1.8f + 32.f);
     } else {
@@ -35,23 +44,56 @@ std::optional<float> TempSensor::getTempF() {
 }
 
 time_t TempSensor::getTempTime() {
-    time_t v;
-    v = this->lastTempTime;
-    return v;
+    std::lock_guard<PiMutex> lock(this->lock);
+    return this->lastTempTime;
 }
 
-void TempSensor::runPolling() {
-    char tempBuf[8];
+uint64_t TempSensor::getSampleCount() {
+    std::lock_guard<PiMutex> lock(this->lock);
+    return this->sampleCount;
+}
+
+uint64_t TempSensor::getFailures() {
+    std::lock_guard<PiMutex> lock(this->lock);
+    return this->failures;
+}
+
+ino_t TempSensor::getInode() {
+    return this->inode;
+}
+
+void TempSensor::poll() {
+    char tempBuf[16];
+    std::optional<float> temp;
+    bool failed = true;
 
+    lseek(this->fd, 0, SEEK_SET);
+    ssize_t l = read(this->fd, tempBuf, sizeof(tempBuf) - 1);
+
+    if (l>0) {
+        tempBuf[l] = 0;
+        char *end;
+        long milliC = std::strtol(tempBuf, &end, 10);
+
+        if (end!=tempBuf && (*end==0 || *end=='\n')) {
+            failed = false;
+            // 85C is what the DS18B20 reports after a power-on reset, not a reading
+            if (milliC!=85000) temp = milliC / 1000.f;
+        }
+    }
+
+    std::lock_guard<PiMutex> lock(this->lock);
+    this->lastTemp = temp;
+    this->lastTempTime = time(NULL);
+    this->sampleCount++;
+    this->failures = failed ? this->failures + 1 : 0;
+}
+
+void TempSensor::runPolling() {
     spdlog::info("Starting polling for temp sensor {}", this->id);
     while(this->runPoll) {
-        lseek(this->fd, 0, SEEK_SET);
-        size_t l = read(this->fd, tempBuf, 8);
-
-        this->lastTemp = std::strtof(tempBuf, 0) / 1000.f;
-        this->lastTempTime = time(NULL);
-        
         usleep(500 * 1000);
+        this->poll();
     }
     spdlog::info("Ending polling for temp sensor {}", this->id);
 }
\ No newline at end of file
@@ -5,28 +5,44 @@
 #include <ctime>
 #include <string>
 #include <optional>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+#include "realtime.h"
 
 class TempSensor {
 public:
-    TempSensor(std::string id);
+    TempSensor(std::string id, std::string devicesDir);
     ~TempSensor();
 
     std::optional<float> getTempC();
     std::optional<float> getTempF();
 
     time_t getTempTime();
+    // incremented on every read attempt, so callers can tell a new sample arrived
+    uint64_t getSampleCount();
+    // reads in a row that failed, 0 after any that didn't
+    uint64_t getFailures();
+    // of the temperature file as opened, 0 if it couldn't be
+    ino_t getInode();
 
 private:
     //std::string tempPath;
     int fd;
+    ino_t inode;
     std::string id;
 
+    // the control loop reads it, possibly as SCHED_FIFO
+    PiMutex lock;
     std::optional<float> lastTemp;
     time_t lastTempTime;
+    uint64_t sampleCount;
+    uint64_t failures;
 
     bool runPoll;
 
     std::shared_ptr<std::thread> pollThread;
 
+    void poll();
     void runPolling();
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "text_field.h"
+#include <algorithm>
+
+TextField::TextField(uint8_t x, uint8_t y, uint8_t height)
+:x(x), y(y), height(height), rendered(false), dirty(false), dirtyRect{0, 0, 0, 0} {
+    this->text.reserve(32);
+}
+
+void TextField::update(ST7920 &lcd, std::string_view str) {
+    if (this->rendered && str==this->text) return;
+
+    uint8_t w = lcd.getCharWidth();
+    size_t maxCells = std::min<size_t>((128 - this->x + w - 1) / w, 32);
+    size_t cells = std::min(std::max(str.size(), this->text.size()), maxCells);
+
+    // a glyph may overhang into the next cell by a pixel, so a changed
+    // character also clears its right neighbour and redraws its left one
+    uint32_t clear = 0;
+    for (size_t i=0;i<cells;i++) {
+        char oldC = i < this->text.size() ? this->text[i] : ' ';
+        char newC = i < str.size() ? str[i] : ' ';
+        if (!this->rendered || oldC!=newC) {
+            clear |= 1u << i;
+            if (i+1<maxCells) clear |= 1u << (i+1);
+        }
+    }
+    uint32_t draw = clear | (clear >> 1);
+
+    for (size_t i=0;i<maxCells;i++) {
+        if (!(clear & (1u << i))) continue;
+        uint8_t cx = this->x + i * w;
+        lcd.setRegion(cx, this->y, cx + w - 1, this->y + this->height - 1, false);
+        this->markDirty(cx, cx + w - 1);
+    }
+
+    for (size_t i=0;i<str.size() && i<maxCells;i++) {
+        if (draw & (1u << i)) lcd.putChar(this->x + i * w, this->y, (unsigned char)str[i]);
+    }
+
+    this->text.assign(str);
+    this->rendered = true;
+}
+
+void TextField::markDirty(uint8_t x1, uint8_t x2) {
+    x2 = std::min<uint8_t>(x2, 127);
+    if (!this->dirty) {
+        this->dirtyRect = { x1, this->y, x2, (uint8_t)(this->y + this->height - 1) };
+        this->dirty = true;
+    } else {
+        this->dirtyRect.x1 = std::min(this->dirtyRect.x1, x1);
+        this->dirtyRect.x2 = std::max(this->dirtyRect.x2, x2);
+    }
+}
+
+bool TextField::isDirty() {
+    return this->dirty;
+}
+
+Rect TextField::getDirty() {
+    return this->dirtyRect;
+}
+
+void TextField::clearDirty() {
+    this->dirty = false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "st7920.h"
+
+struct Rect {
+    uint8_t x1, y1, x2, y2;
+};
+
+// A single line of text on the lcd that remembers what it last rendered.
+// Only the character cells that changed are cleared and redrawn, and the
+// area touched is reported as a dirty rectangle for the next flush.
+// Assumes a monospaced font.
+class TextField {
+public:
+    TextField(uint8_t x, uint8_t y, uint8_t height);
+
+    void update(ST7920 &lcd, std::string_view str);
+
+    bool isDirty();
+    Rect getDirty();
+    void clearDirty();
+
+private:
+    uint8_t x;
+    uint8_t y;
+    uint8_t height;
+
+    std::string text;
+    bool rendered;
+
+    bool dirty;
+    Rect dirtyRect;
+
+    void markDirty(uint8_t x1, uint8_t x2);
+};
@@ -0,0 +1,69 @@
+#include "web_util.h"
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+std::string_view remoteAddress(const struct mg_connection *c) {
+    const char *remoteAddr = mg_get_header(c, "X-Real-IP");
+    const struct mg_request_info *req = mg_get_request_info(c);
+
+    if (remoteAddr==NULL) remoteAddr = req->remote_addr;
+    // unix socket clients have no address
+    if (remoteAddr[0]=='\0') remoteAddr = "local";
+
+    return std::string_view(remoteAddr);
+}
+
+std::string remoteAddressStr(const struct mg_connection *c) {
+    return std::string(remoteAddress(c));
+}
+
+struct mg_context *startWebServer(const struct mg_callbacks *cbs, void *data, const Options &options) {
+    // civetweb takes a unix socket as an 'x' prefixed listening port
+    std::string ports = options.listen;
+    if (!options.unixSocket.empty()) {
+        struct stat st;
+        if (lstat(options.unixSocket.c_str(), &st)==0 && S_ISSOCK(st.st_mode)) {
+            spdlog::info("Removing old socket {}", options.unixSocket);
+            unlink(options.unixSocket.c_str());
+        }
+
+        if (!ports.empty()) ports += ",";
+        ports += "x" + options.unixSocket;
+    }
+
+    std::string threads = std::to_string(options.webThreads);
+    const char *opts[] = {
+        "listening_ports", ports.c_str(),
+        "num_threads", threads.c_str(),
+        "enable_keep_alive", "yes",
+        "enable_websocket_ping_pong", "yes",
+        NULL, NULL
+    };
+
+    // the socket never exists with looser permissions than asked for
+    mode_t mask = umask(~options.unixSocketMode & 0777);
+    struct mg_context *ctx = mg_start(cbs, data, opts);
+    umask(mask);
+
+    if (ctx==nullptr) {
+        spdlog::error("Couldn't start web server on {}", ports);
+        throw "Couldn't start web server";
+    }
+
+    if (!options.unixSocket.empty()) {
+        if (chmod(options.unixSocket.c_str(), options.unixSocketMode)!=0) {
+            spdlog::warn("Couldn't set permissions on {}: ({}) {}", options.unixSocket, errno, strerror(errno));
+        }
+        spdlog::info("Listening on {} ({:04o})", options.unixSocket, options.unixSocketMode);
+    }
+
+    return ctx;
+}
+
+void stopWebServer(struct mg_context *ctx, const Options &options) {
+    mg_stop(ctx);
+    if (!options.unixSocket.empty()) unlink(options.unixSocket.c_str());
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <civetweb.h>
+#include <string>
+#include <string_view>
+#include "options.h"
+
+// the client's address, or the one a reverse proxy passed on in X-Real-IP.
+// The view is good for as long as the request.
+std::string_view remoteAddress(const struct mg_connection *c);
+std::string remoteAddressStr(const struct mg_connection *c);
+
+// Starts civetweb on the tcp listener and/or unix socket in options. The
+// socket is created with options.unixSocketMode; one left behind by a previous
+// run is replaced. Throws if the server can't be started.
+struct mg_context *startWebServer(const struct mg_callbacks *cbs, void *data, const Options &options);
+
+// stops civetweb and removes the unix socket
+void stopWebServer(struct mg_context *ctx, const Options &options);
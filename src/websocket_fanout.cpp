@@ -0,0 +1,82 @@
+#include "websocket_fanout.h"
+#include <algorithm>
+
+WebsocketFanout::Client::Client(struct mg_connection *conn)
+:conn(conn), subscribed(true), closing(false) {
+}
+
+WebsocketFanout::~WebsocketFanout() {
+    std::unique_lock<std::mutex> lock(this->lock);
+    while (!this->clients.empty()) {
+        std::list<Client>::iterator client = this->clients.begin();
+        lock.unlock();
+        this->close(client);
+        lock.lock();
+    }
+}
+
+void WebsocketFanout::add(struct mg_connection *c) {
+    std::lock_guard<std::mutex> lock(this->lock);
+    Client &client = this->clients.emplace_back(c);
+    client.writer = std::thread(&WebsocketFanout::runWriter, this, std::ref(client));
+}
+
+void WebsocketFanout::remove(const struct mg_connection *c) {
+    std::list<Client>::iterator client;
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        client = std::find_if(this->clients.begin(), this->clients.end(), [c](const Client &client) { return client.conn==c; });
+        if (client==this->clients.end()) return;
+    }
+    // civetweb closes a connection on its own thread, and frees it once this
+    // returns, so its writer has to be finished with it by then
+    this->close(client);
+}
+
+void WebsocketFanout::subscribe(const struct mg_connection *c, bool subscribed) {
+    std::lock_guard<std::mutex> lock(this->lock);
+    for (Client &client : this->clients) {
+        if (client.conn==c) client.subscribed = subscribed;
+    }
+}
+
+size_t WebsocketFanout::size() {
+    std::lock_guard<std::mutex> lock(this->lock);
+    return this->clients.size();
+}
+
+void WebsocketFanout::broadcast(std::string_view message) {
+    std::shared_ptr<const std::string> shared = std::make_shared<const std::string>(message);
+    std::lock_guard<std::mutex> lock(this->lock);
+    for (Client &client : this->clients) {
+        if (!client.subscribed || client.closing) continue;
+        client.pending = shared;
+        client.wake.notify_one();
+    }
+}
+
+void WebsocketFanout::runWriter(Client &client) {
+    std::unique_lock<std::mutex> lock(this->lock);
+    while (true) {
+        client.wake.wait(lock, [&client]() { return client.closing || client.pending; });
+        if (client.closing) return;
+
+        std::shared_ptr<const std::string> message = std::move(client.pending);
+        client.pending.reset();
+        lock.unlock();
+        mg_websocket_write(client.conn, MG_WEBSOCKET_OPCODE_TEXT, message->data(), message->size());
+        lock.lock();
+    }
+}
+
+void WebsocketFanout::close(std::list<Client>::iterator client) {
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+        client->closing = true;
+        client->wake.notify_one();
+    }
+    client->writer.join();
+
+    std::lock_guard<std::mutex> lock(this->lock);
+    this->clients.erase(client);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <civetweb.h>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Websocket clients that are sent every published message. A message is
+// serialized once by the publisher and handed to each subscribed client's
+// writer thread, which sends the latest one it has. A slow client only falls
+// behind on its own messages, never the others'. Clients are subscribed when
+// they're added.
+class WebsocketFanout {
+public:
+    ~WebsocketFanout();
+
+    void add(struct mg_connection *c);
+    // waits for a write in progress to this connection, but no other
+    void remove(const struct mg_connection *c);
+    void subscribe(const struct mg_connection *c, bool subscribed);
+    size_t size();
+
+    void broadcast(std::string_view message);
+
+private:
+    struct Client {
+        struct mg_connection *conn;
+        bool subscribed;
+        bool closing;
+        // replaced if a newer message comes before the last one was written
+        std::shared_ptr<const std::string> pending;
+        std::condition_variable wake;
+        std::thread writer;
+
+        Client(struct mg_connection *conn);
+    };
+
+    std::mutex lock;
+    std::list<Client> clients;
+
+    void runWriter(Client &client);
+    // stops and joins the client's writer, then forgets it
+    void close(std::list<Client>::iterator client);
+};
@@ -0,0 +1,203 @@
+// Drives ProbeRoles through a fake 1-wire devices directory: probes are
+// created, removed and created again, and each role has to attach and
+// detach to follow them. Exits non-zero if any check fails.
+#include "probe_roles.h"
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+
+#define FERMENTER_PROBE "28-000000000001"
+#define AMBIENT_PROBE "28-000000000002"
+#define OTHER_PROBE "28-000000000003"
+#define SPARE_PROBE "28-000000000004"
+
+// short, so the checks made on each rescan come round quickly
+#define RESCAN_INTERVAL 200
+// the watcher gets inotify events straight away on most filesystems, this
+// leaves plenty of room for it either way
+#define WAIT_TIMEOUT_MS 5000
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// made aside and renamed in, sysfs devices appear with their files in place
+static void writeProbe(const std::filesystem::path &dir, const std::string &id, int milliC) {
+    std::filesystem::path staging = dir.parent_path() / (dir.filename().string() + "-" + id);
+    std::filesystem::create_directory(staging);
+    {
+        std::ofstream temperature(staging / "temperature");
+        temperature << milliC << "\n";
+    }
+    std::filesystem::rename(staging, dir / id);
+}
+
+// a new temperature node in place of the old, as if the probe was unplugged
+// and plugged back in between rescans. The watched directory sees nothing.
+static void replaceTemperature(const std::filesystem::path &dir, const std::string &id, int milliC) {
+    {
+        std::ofstream temperature(dir / id / "temperature.new");
+        temperature << milliC << "\n";
+    }
+    std::filesystem::rename(dir / id / "temperature.new", dir / id / "temperature");
+}
+
+static bool waitFor(const std::function<bool()> &done) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(WAIT_TIMEOUT_MS);
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
+
+static bool reads(ProbeRoles &roles, size_t role, float tempC) {
+    TempSensor *sensor = roles.getSensor(role);
+    if (sensor==nullptr) return false;
+    std::optional<float> temp = sensor->getTempC();
+    return temp.has_value() && std::fabs(temp.value() - tempC) < 0.001f;
+}
+
+static void run(const std::filesystem::path &dir) {
+    writeProbe(dir, FERMENTER_PROBE, 20500);
+
+    ProbeRoles roles(dir.string(), RESCAN_INTERVAL);
+    size_t fermenter = roles.add("fermenter", "28-ffffffffffff");
+    size_t ambient = roles.add("ambient", AMBIENT_PROBE);
+    roles.setId(fermenter, FERMENTER_PROBE);
+
+    CHECK(roles.size()==2);
+    CHECK(roles.getRole(fermenter)=="fermenter");
+    CHECK(roles.getId(fermenter)==FERMENTER_PROBE);
+
+    // only the fermenter probe is there to start with
+    CHECK(roles.attach(fermenter));
+    CHECK(!roles.attach(ambient));
+    CHECK(roles.isAttached(fermenter));
+    CHECK(!roles.isAttached(ambient));
+    CHECK(reads(roles, fermenter, 20.5f));
+    CHECK(roles.getSensor(ambient)==nullptr);
+
+    roles.watch();
+
+    // the ambient probe turns up
+    writeProbe(dir, AMBIENT_PROBE, 18000);
+    CHECK(waitFor([&]() { return roles.isAttached(ambient); }));
+    CHECK(reads(roles, ambient, 18.0f));
+    CHECK(roles.isAttached(fermenter));
+
+    // a probe with no role changes nothing
+    writeProbe(dir, OTHER_PROBE, 30000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK(reads(roles, fermenter, 20.5f));
+    CHECK(reads(roles, ambient, 18.0f));
+
+    // the fermenter probe is unplugged, its sensor is kept until the
+    // control loop's tick is over
+    std::filesystem::remove_all(dir / FERMENTER_PROBE);
+    CHECK(waitFor([&]() { return !roles.isAttached(fermenter); }));
+    CHECK(roles.getSensor(fermenter)==nullptr);
+    CHECK(roles.isAttached(ambient));
+    CHECK(roles.retiredCount()==1);
+    roles.sweep();
+    CHECK(roles.retiredCount()==1);
+    roles.endTick();
+    roles.sweep();
+    CHECK(roles.retiredCount()==0);
+
+    // and plugged back in
+    writeProbe(dir, FERMENTER_PROBE, 21000);
+    CHECK(waitFor([&]() { return roles.isAttached(fermenter); }));
+    CHECK(reads(roles, fermenter, 21.0f));
+
+    // replugged between rescans, the old sensor is left reading a node
+    // that's gone and has to be replaced
+    TempSensor *replugged = roles.getSensor(fermenter);
+    replaceTemperature(dir, FERMENTER_PROBE, 22000);
+    CHECK(waitFor([&]() { return roles.getSensor(fermenter)!=replugged && reads(roles, fermenter, 22.0f); }));
+
+    // a probe whose directory shows up before its temperature file can't be
+    // read at first, and is reattached once it can
+    std::filesystem::remove_all(dir / AMBIENT_PROBE);
+    CHECK(waitFor([&]() { return !roles.isAttached(ambient); }));
+    std::filesystem::create_directory(dir / AMBIENT_PROBE);
+    CHECK(waitFor([&]() { return roles.isAttached(ambient); }));
+    replaceTemperature(dir, AMBIENT_PROBE, 19000);
+    CHECK(waitFor([&]() { return reads(roles, ambient, 19.0f); }));
+
+    // the ambient role is moved to another probe while running, and its old
+    // probe no longer matters to it
+    CHECK(roles.assign(ambient, OTHER_PROBE));
+    CHECK(roles.getId(ambient)==OTHER_PROBE);
+    CHECK(reads(roles, ambient, 30.0f));
+    std::filesystem::remove_all(dir / AMBIENT_PROBE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(RESCAN_INTERVAL * 2));
+    CHECK(reads(roles, ambient, 30.0f));
+
+    // moved to a probe that isn't there yet, it's attached when it turns up
+    CHECK(!roles.assign(fermenter, SPARE_PROBE));
+    CHECK(!roles.isAttached(fermenter));
+    writeProbe(dir, SPARE_PROBE, 15000);
+    CHECK(waitFor([&]() { return reads(roles, fermenter, 15.0f); }));
+
+    // both go
+    std::filesystem::remove_all(dir / SPARE_PROBE);
+    std::filesystem::remove_all(dir / OTHER_PROBE);
+    CHECK(waitFor([&]() { return !roles.isAttached(fermenter) && !roles.isAttached(ambient); }));
+}
+
+static void checkLookups() {
+    ProbeRoles roles("/nonexistent", RESCAN_INTERVAL);
+    size_t fermenter = roles.add("fermenter", FERMENTER_PROBE);
+    size_t ambient = roles.add("ambient", AMBIENT_PROBE);
+
+    size_t role = 99;
+    CHECK(roles.findRole("ambient", role) && role==ambient);
+    CHECK(roles.findRole("fermenter", role) && role==fermenter);
+    CHECK(!roles.findRole("Ambient", role));
+    CHECK(!roles.findRole("", role));
+
+    CHECK(ProbeRoles::validId("28-0517602ef2ff"));
+    CHECK(ProbeRoles::validId("28-0"));
+    CHECK(!ProbeRoles::validId("28-"));
+    CHECK(!ProbeRoles::validId("28-0517602EF2FF"));
+    CHECK(!ProbeRoles::validId("10-0517602ef2ff"));
+    CHECK(!ProbeRoles::validId("28-../../etc"));
+    CHECK(!ProbeRoles::validId("28-0517602ef2ff/"));
+    CHECK(!ProbeRoles::validId("28-00000000000000000"));
+}
+
+int main() {
+    spdlog::set_level(spdlog::level::warn);
+
+    std::string dirTemplate = (std::filesystem::temp_directory_path() / "brewserver-probes-XXXXXX").string();
+    if (mkdtemp(dirTemplate.data())==nullptr) {
+        printf("Couldn't create a temporary directory\n");
+        return 1;
+    }
+    std::filesystem::path dir(dirTemplate);
+
+    checkLookups();
+    run(dir);
+
+    std::filesystem::remove_all(dir);
+
+    if (failures>0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Rasterizes the glyphs the lcd needs into constexpr tables.
+//
+// usage: fontgen FONT OUTPUT SIZE...
+#include "font.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+    if (argc<4) {
+        fprintf(stderr, "usage: %s FONT OUTPUT SIZE...\n", argv[0]);
+        return 1;
+    }
+
+    FT_Library ftLib;
+    FT_Face face;
+
+    if (FT_Init_FreeType(&ftLib)) {
+        fprintf(stderr, "Couldn't initialize Freetype\n");
+        return 1;
+    }
+
+    if (FT_New_Face(ftLib, argv[1], 0, &face)) {
+        fprintf(stderr, "Couldn't load font %s\n", argv[1]);
+        return 1;
+    }
+
+    std::string out;
+    out += "// Generated by tools/fontgen from ";
+    out += argv[1];
+    out += ", do not edit.\n";
+    out += "#pragma once\n#include \"font.h\"\n\n";
+
+    std::vector<int> sizes;
+    for (int i=3;i<argc;i++) sizes.push_back(std::atoi(argv[i]));
+
+    char buf[128];
+    for (int size : sizes) {
+        if (FT_Set_Pixel_Sizes(face, 0, size)) {
+            fprintf(stderr, "Couldn't set font size %d\n", size);
+            return 1;
+        }
+
+        std::vector<uint8_t> bitmaps;
+        std::string glyphs;
+
+        for (size_t i=0;i<bakedGlyphCount;i++) {
+            FT_UInt index = i==0 ? 0 : FT_Get_Char_Index(face, bakedGlyphChar(i));
+            if (FT_Load_Glyph(face, index, FT_LOAD_RENDER | FT_LOAD_TARGET_MONO | FT_LOAD_MONOCHROME)) {
+                fprintf(stderr, "couldn't load glyph %lu\n", bakedGlyphChar(i));
+                return 1;
+            }
+
+            FT_GlyphSlot g = face->glyph;
+            int pitch = (g->bitmap.width + 7) / 8;
+            size_t offset = bitmaps.size();
+            for (unsigned int r=0;r<g->bitmap.rows;r++) {
+                for (int b=0;b<pitch;b++) bitmaps.push_back(g->bitmap.buffer[r * g->bitmap.pitch + b]);
+            }
+
+            snprintf(buf, sizeof(buf), "    { %d, %d, %u, %u, %ld, %zu }, // 0x%02lx\n",
+                g->bitmap_left, g->bitmap_top, g->bitmap.width, g->bitmap.rows, g->advance.x / 64, offset, bakedGlyphChar(i));
+            glyphs += buf;
+        }
+
+        snprintf(buf, sizeof(buf), "constexpr uint8_t font%dBitmaps[] = {", size);
+        out += buf;
+        for (size_t i=0;i<bitmaps.size();i++) {
+            snprintf(buf, sizeof(buf), "%s0x%02x,", i % 16 ? " " : "\n    ", bitmaps[i]);
+            out += buf;
+        }
+        out += "\n};\n\n";
+
+        snprintf(buf, sizeof(buf), "constexpr BakedGlyph font%dGlyphs[bakedGlyphCount] = {\n", size);
+        out += buf;
+        out += glyphs;
+        out += "};\n\n";
+    }
+
+    out += "constexpr BakedFont bakedFonts[] = {\n";
+    for (int size : sizes) {
+        FT_Set_Pixel_Sizes(face, 0, size);
+        snprintf(buf, sizeof(buf), "    { %d, %ld, font%dGlyphs, font%dBitmaps },\n", size, face->size->metrics.ascender / 64, size, size);
+        out += buf;
+    }
+    out += "};\n";
+
+    FT_Done_Face(face);
+    FT_Done_FreeType(ftLib);
+
+    FILE *f = fopen(argv[2], "w");
+    if (f==nullptr) {
+        fprintf(stderr, "Couldn't write %s\n", argv[2]);
+        return 1;
+    }
+    fputs(out.c_str(), f);
+    fclose(f);
+
+    return 0;
+}